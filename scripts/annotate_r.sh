@@ -32,8 +32,6 @@ fi
 $RCHK/scripts/check_r.sh csfpcheck
 
   # csfpcheck output is "filename line_no"
-  # by the sed command below it is converted to
-  #   "filename sed_command_to_add_annotation"
-find . -name *.csfpcheck -exec cat {} \; | \
-  sed -e 's/\([^ \t]\+\) \(.*\)/\1 \2,\2s\/$\/\\\\\/* GC *\\\\\/\/g/g' | \
-  sed_multifile
+  # the annotate tool appends the comment to these lines, rewriting each file once
+  #   (run with -n instead to get a patch)
+find . -name *.csfpcheck -exec cat {} \; | $RCHK/src/annotate
@@ -101,7 +101,12 @@ for T in $TOOLS ; do
   find $PKGDIR -name "*.bc" | grep -v '\.o\.bc' | while read F ; do
     FOUT=`echo $F | sed -e 's/\.bc$/.'$T'/g'`
     if [ ! -r $FOUT ] || [ $F -nt $FOUT ] || [ $RBC -nt $FOUT ] ; then
-      $RCHK/src/$T $RBC $F >$FOUT 2>&1
+      if [ $T == fficheck ] ; then
+        # fficheck only needs the package code
+        $RCHK/src/$T -p $F >$FOUT 2>&1
+      else
+        $RCHK/src/$T $RBC $F >$FOUT 2>&1
+      fi
     fi
   done
 done
@@ -0,0 +1,52 @@
+#! /bin/bash
+
+# checks that bcheck gives the same results with the visited guard valuations kept in BDDs
+# (RCHK_SYMBOLIC_GUARDS) as with the explicit sets of states
+#
+# the reports and the numbers of traversed states are compared; functions that use a local
+# variable with vector-only operations (LENGTH, STRING_ELT, ...) without it being a guard are
+# a good test, such variables still get values in the sexp guards
+#
+# Usage:
+#
+#   cmp_symbolic_guards.sh base_file.bc [module_file.bc]
+#
+# Examples:
+#
+#   check the R binary:       ./cmp_symbolic_guards.sh ./src/main/R.bin.bc
+#   check a package:          ./cmp_symbolic_guards.sh ./src/main/R.bin.bc packages/lib/png/libs/png.so.bc
+
+if [ ! -x $RCHK/src/bcheck ] ; then
+  echo "Please set RCHK variables (scripts/config.inc) and RCHK installation - cannot find tool bcheck." >&2
+  exit 2
+fi
+
+if [ X"$1" == X ] || [ ! -r "$1" ] ; then
+  echo "Usage: cmp_symbolic_guards.sh base_file.bc [module_file.bc]" >&2
+  exit 2
+fi
+
+OUT=`mktemp -d`
+trap "rm -rf $OUT" EXIT
+
+$RCHK/src/bcheck "$@" >$OUT/explicit.out 2>$OUT/explicit.err
+RES_EXPLICIT=$?
+RCHK_SYMBOLIC_GUARDS=1 $RCHK/src/bcheck "$@" >$OUT/symbolic.out 2>$OUT/symbolic.err
+RES_SYMBOLIC=$?
+
+if [ $RES_EXPLICIT -ne 0 ] || [ $RES_SYMBOLIC -ne 0 ] ; then
+  echo "bcheck failed (exit status $RES_EXPLICIT explicit, $RES_SYMBOLIC symbolic)" >&2
+  tail -5 $OUT/symbolic.err >&2
+  exit 1
+fi
+
+RES=0
+if ! diff -u $OUT/explicit.out $OUT/symbolic.out ; then
+  echo "The reports differ." >&2
+  RES=1
+fi
+if ! diff -u <(grep '^Analyzed' $OUT/explicit.err) <(grep '^Analyzed' $OUT/symbolic.err) ; then
+  echo "The numbers of traversed states differ." >&2
+  RES=1
+fi
+exit $RES
@@ -1,6 +1,8 @@
 
 #include "allocators.h"
+#include "analysiscache.h"
 #include "exceptions.h"
+#include "moduleindex.h"
 #include "patterns.h"
 
 using namespace llvm;
@@ -8,7 +10,6 @@ using namespace llvm;
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Function.h>
-#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
 
@@ -48,20 +49,18 @@ void findPossiblyReturnedVariables(Function *f, VarsSetTy& possiblyReturned) {
     return;
   }
   if (DEBUG) errs() << "Function " << funName(f) << "...\n";
+  const FunctionIndexTy& findex = ModuleIndexTy::get(f->getParent()).getFunction(f);
   
   // insert variables values of which are directly returned
-  for(inst_iterator ini = inst_begin(*f), ine = inst_end(*f); ini != ine; ++ini) {
-    Instruction *in = &*ini;
-    if (ReturnInst::classof(in)) {
-      Value* returnOperand = cast<ReturnInst>(in)->getReturnValue();
-
-      ValuesSetTy vorig = valueOrigins(returnOperand); 
-      for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
-        Value *v = *vi;
-        if (AllocaInst* var = dyn_cast<AllocaInst>(v)) {
-          possiblyReturned.insert(var);
-          if (DEBUG) errs() << "  directly returned " << varName(var) << "(" << *var << ")\n";
-        }
+  for(std::vector<ReturnInst*>::const_iterator ri = findex.returns.begin(), re = findex.returns.end(); ri != re; ++ri) {
+    Value* returnOperand = (*ri)->getReturnValue();
+
+    ValuesSetTy vorig = valueOrigins(returnOperand); 
+    for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
+      Value *v = *vi;
+      if (AllocaInst* var = dyn_cast<AllocaInst>(v)) {
+        possiblyReturned.insert(var);
+        if (DEBUG) errs() << "  directly returned " << varName(var) << "(" << *var << ")\n";
       }
     }
   }
@@ -73,26 +72,21 @@ void findPossiblyReturnedVariables(Function *f, VarsSetTy& possiblyReturned) {
   while (addedVar) {
     addedVar = false;
     
-    for(inst_iterator ini = inst_begin(*f), ine = inst_end(*f); ini != ine; ++ini) {
-      Instruction *in = &*ini;
-      if (StoreInst::classof(in)) {
-        Value *storePointerOperand = cast<StoreInst>(in)->getPointerOperand();
-        if (!AllocaInst::classof(storePointerOperand)) continue;
-        
-        AllocaInst* dst = cast<AllocaInst>(storePointerOperand);
-        if (possiblyReturned.find(dst) == possiblyReturned.end()) {
-          continue;
-        }
+    for(std::vector<StoreInst*>::const_iterator si = findex.varStores.begin(), se = findex.varStores.end(); si != se; ++si) {
+      StoreInst *in = *si;
+      AllocaInst* dst = cast<AllocaInst>(in->getPointerOperand());
+      if (possiblyReturned.find(dst) == possiblyReturned.end()) {
+        continue;
+      }
         
-        ValuesSetTy vorig = valueOrigins(cast<StoreInst>(in)->getValueOperand());
-        for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
-          Value *v = *vi;
-          if (AllocaInst* src = dyn_cast<AllocaInst>(v)) {
-            if (possiblyReturned.find(src) == possiblyReturned.end()) {
-              possiblyReturned.insert(src);
-              addedVar = true;
-              if (DEBUG) errs() << "  indirectly returned " << varName(src) << " through " << varName(dst) << " store " << *in << "\n";
-            }
+      ValuesSetTy vorig = valueOrigins(in->getValueOperand());
+      for(ValuesSetTy::iterator vi = vorig.begin(), ve = vorig.end(); vi != ve; ++vi) { 
+        Value *v = *vi;
+        if (AllocaInst* src = dyn_cast<AllocaInst>(v)) {
+          if (possiblyReturned.find(src) == possiblyReturned.end()) {
+            possiblyReturned.insert(src);
+            addedVar = true;
+            if (DEBUG) errs() << "  indirectly returned " << varName(src) << " through " << varName(dst) << " store " << *in << "\n";
           }
         }
       }
@@ -150,40 +144,42 @@ void getWrappedAllocators(Function *f, FunctionsSetTy& wrappedAllocators, Functi
 
   VarsSetTy possiblyReturnedVars;
   findPossiblyReturnedVariables(f, possiblyReturnedVars);
+  const FunctionIndexTy& findex = ModuleIndexTy::get(f->getParent()).getFunction(f);
       
-  for(Function::iterator bb = f->begin(), bbe = f->end(); bb != bbe; ++bb) {
-    for(BasicBlock::iterator in = bb->begin(), ine = bb->end(); in != ine; ++in) {
-      Value *v = &*in;
-      CallSite cs(v);
-      if (!cs) continue;
-      Function *tgt = cs.getCalledFunction();
-      if (tgt == gcFunction) {
-        // an exception: treat a call to R_gc_internal as an indication this is a direct allocator
-        // (note: R_gc_internal itself does not return an SEXP)
-        if (DEBUG) errs() << "SEXP function " << funName(f) << " calls directly into " << funName(tgt) << "\n";
-        wrappedAllocators.insert(tgt);
-        continue;
-      }
-      if (isCallThroughPointer(v) && valueMayBeReturned(v, possiblyReturnedVars)) {
-        if (DEBUG) errs() << "SEXP function " << funName(f) << " calls through a pointer, asserted to call gc function\n";
-        wrappedAllocators.insert(gcFunction);
-        continue;
-      }
-      if (!tgt) continue;
-      if (!isSEXP(tgt->getReturnType())) continue;
-      if (isKnownNonAllocator(tgt)) continue;
-        
-      // tgt is a function returning an SEXP, check if the result may be returned by function f
-      if (valueMayBeReturned(v, possiblyReturnedVars)) {
-        if (DEBUG) errs() << "SEXP function " << funName(f) << " wraps function " << funName(tgt) << "\n";
-        wrappedAllocators.insert(tgt);
-      }
+  for(std::vector<IndexedCallSiteTy>::const_iterator ci = findex.callSites.begin(), ce = findex.callSites.end(); ci != ce; ++ci) {
+    Value *v = ci->inst;
+    Function *tgt = ci->target;
+    if (tgt == gcFunction) {
+      // an exception: treat a call to R_gc_internal as an indication this is a direct allocator
+      // (note: R_gc_internal itself does not return an SEXP)
+      if (DEBUG) errs() << "SEXP function " << funName(f) << " calls directly into " << funName(tgt) << "\n";
+      wrappedAllocators.insert(tgt);
+      continue;
+    }
+    if (isCallThroughPointer(v) && valueMayBeReturned(v, possiblyReturnedVars)) {
+      if (DEBUG) errs() << "SEXP function " << funName(f) << " calls through a pointer, asserted to call gc function\n";
+      wrappedAllocators.insert(gcFunction);
+      continue;
+    }
+    if (!tgt) continue;
+    if (!isSEXP(tgt->getReturnType())) continue;
+    if (isKnownNonAllocator(tgt)) continue;
+      
+    // tgt is a function returning an SEXP, check if the result may be returned by function f
+    if (valueMayBeReturned(v, possiblyReturnedVars)) {
+      if (DEBUG) errs() << "SEXP function " << funName(f) << " wraps function " << funName(tgt) << "\n";
+      wrappedAllocators.insert(tgt);
     }
   }
 }
 
 void findPossibleAllocators(Module *m, FunctionsSetTy& possibleAllocators) {
 
+  bool cacheable = possibleAllocators.empty();
+  if (cacheable && loadCachedFunctions(m, "possibleallocators", possibleAllocators)) {
+    return;
+  }
+
   FunctionsSetTy onlyFunctions;
   CallEdgesMapTy onlyEdges;
   Function* gcFunction = getGCFunction(m);
@@ -222,6 +218,9 @@ void findPossibleAllocators(Module *m, FunctionsSetTy& possibleAllocators) {
   }
   
   possibleAllocators.insert(gcFunction);
+  if (cacheable) {
+    saveCachedFunctions(m, "possibleallocators", possibleAllocators);
+  }
 }
 
 bool isAllocatingFunction(Function *fun, FunctionsInfoMapTy& functionsMap, unsigned gcFunctionIndex) {
@@ -240,6 +239,11 @@ bool isAllocatingFunction(Function *fun, FunctionsInfoMapTy& functionsMap, unsig
 
 void findAllocatingFunctions(Module *m, FunctionsSetTy& allocatingFunctions) {
 
+  bool cacheable = allocatingFunctions.empty();
+  if (cacheable && loadCachedFunctions(m, "allocatingfunctions", allocatingFunctions)) {
+    return;
+  }
+
   FunctionsSetTy onlyFunctions;
 
   for(Module::iterator fi = m->begin(), fe = m->end(); fi != fe; ++fi) {
@@ -263,4 +267,7 @@ void findAllocatingFunctions(Module *m, FunctionsSetTy& allocatingFunctions) {
     }
   }
   allocatingFunctions.insert(getGCFunction(m));
+  if (cacheable) {
+    saveCachedFunctions(m, "allocatingfunctions", allocatingFunctions);
+  }
 }
@@ -19,6 +19,9 @@
 #include "callocators.h"
 #include "errors.h"
 #include "cprotect.h"
+#include "dataflow.h"
+#include "deadline.h"
+#include "counters.h"
 
 using namespace llvm;
 
@@ -208,4 +211,7 @@ int main(int argc, char* argv[])
 
   CalledModuleTy::release(cm);  
   delete m;
+  printDataflowStats();
+  printTimeouts();
+  printCounters();
 }
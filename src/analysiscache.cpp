@@ -0,0 +1,153 @@
+
+#include "analysiscache.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+using namespace llvm;
+
+// the cache file has a header line with the analysis and the inputs hash, and then one record per
+// line (for sets of functions, a function name)
+
+static std::string cacheFileName(Module *m, const std::string& analysis, uint64_t& hash) {
+
+  const char *dir = getenv("RCHK_ANALYSIS_CACHE");
+  if (!dir || !*dir) {
+    dir = getenv("RCHK_CHECKPOINT"); // a resumed run does not compute the module analyses again
+  }
+  if (!dir || !*dir) {
+    return "";
+  }
+  hash = moduleInputsHash(m);
+
+  std::string fileName;
+  raw_string_ostream os(fileName);
+  os << dir << "/" << moduleFileId(m) << "-" << format_hex_no_prefix(hash, 16) << "." << analysis;
+  return os.str();
+}
+
+static std::string cacheHeader(const std::string& analysis, uint64_t hash) {
+  std::string header;
+  raw_string_ostream os(header);
+  os << "# rchk " << analysis << " " << format_hex_no_prefix(hash, 16);
+  return os.str();
+}
+
+bool loadCachedLines(Module *m, const std::string& analysis, std::vector<std::string>& lines) {
+
+  uint64_t hash;
+  std::string fileName = cacheFileName(m, analysis, hash);
+  if (fileName.empty()) {
+    return false;
+  }
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(fileName);
+  if (!res) {
+    return false;
+  }
+
+  std::pair<StringRef, StringRef> split = res.get()->getBuffer().split('\n');
+  if (split.first != cacheHeader(analysis, hash)) {
+    errs() << "Ignoring invalid analysis cache " << fileName << "\n";
+    return false;
+  }
+
+  StringRef rest = split.second;
+  while(!rest.empty()) {
+    split = rest.split('\n');
+    rest = split.second;
+    lines.push_back(split.first.str());
+  }
+  return true;
+}
+
+void saveCachedLines(Module *m, const std::string& analysis, const std::vector<std::string>& lines) {
+
+  uint64_t hash;
+  std::string fileName = cacheFileName(m, analysis, hash);
+  if (fileName.empty()) {
+    return;
+  }
+
+  // other processes may be reading the file or writing the same result at the same time
+  std::string tmpName = fileName + "." + std::to_string(getpid());
+  int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    errs() << "Cannot write analysis cache " << tmpName << "\n";
+    return;
+  }
+  {
+    raw_fd_ostream out(fd, true);
+    out << cacheHeader(analysis, hash) << "\n";
+    for(std::vector<std::string>::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+      out << *li << "\n";
+    }
+  }
+  if (rename(tmpName.c_str(), fileName.c_str())) {
+    errs() << "Cannot write analysis cache " << fileName << "\n";
+    unlink(tmpName.c_str());
+  }
+}
+
+bool loadCachedFunctions(Module *m, const std::string& analysis, FunctionsSetTy& functions) {
+
+  std::vector<std::string> names;
+  if (!loadCachedLines(m, analysis, names)) {
+    return false;
+  }
+
+  FunctionsSetTy loaded;
+  for(std::vector<std::string>::const_iterator ni = names.begin(), ne = names.end(); ni != ne; ++ni) {
+    Function *f = m->getFunction(*ni);
+    if (!f) {
+      errs() << "Ignoring invalid analysis cache " << analysis << ", unknown function " << *ni << "\n";
+      return false;
+    }
+    loaded.insert(f);
+  }
+  functions.insert(loaded.begin(), loaded.end());
+  return true;
+}
+
+// names are sorted so that the result does not depend on pointer values
+
+static void sortedNames(const FunctionsSetTy& functions, std::vector<std::string>& names) {
+  for(FunctionsSetTy::const_iterator fi = functions.begin(), fe = functions.end(); fi != fe; ++fi) {
+    names.push_back((*fi)->getName().str());
+  }
+  std::sort(names.begin(), names.end());
+}
+
+void saveCachedFunctions(Module *m, const std::string& analysis, const FunctionsSetTy& functions) {
+
+  std::vector<std::string> names;
+  sortedNames(functions, names);
+  saveCachedLines(m, analysis, names);
+}
+
+std::string functionsSetId(const FunctionsSetTy& functions) {
+
+  std::vector<std::string> names;
+  sortedNames(functions, names);
+
+  uint64_t h = 14695981039346656037ULL;
+  for(std::vector<std::string>::const_iterator ni = names.begin(), ne = names.end(); ni != ne; ++ni) {
+    h ^= xxHash64(*ni);
+    h *= 1099511628211ULL;
+  }
+  std::string id;
+  raw_string_ostream os(id);
+  os << format_hex_no_prefix(h, 16);
+  return os.str();
+}
@@ -0,0 +1,40 @@
+#ifndef RCHK_ANALYSISCACHE_H
+#define RCHK_ANALYSISCACHE_H
+
+#include "common.h"
+
+#include <string>
+#include <vector>
+
+#include <llvm/IR/Module.h>
+
+using namespace llvm;
+
+// shared cache of module-level analyses
+//
+// when environment variable RCHK_ANALYSIS_CACHE is set to a directory, results of module-level
+// analyses (sets of functions: error functions, possible allocators, allocating functions; the
+// context-sensitive allocators and the callee-protect functions) are stored there by function
+// name, one file per module and analysis; a process that finds the result of an analysis there
+// does not compute it again, so e.g. the shards of a run (shard.h) only compute them once
+//
+// without RCHK_ANALYSIS_CACHE, the checkpoint directory (RCHK_CHECKPOINT, see checkpoint.h) is
+// used, so that a resumed run does not compute the module analyses again
+//
+// the files are named by the hash of the input files and the rchk build (see moduleInputsHash), so
+// results of changed inputs or of a different version of the tools are not used
+
+// false when the result is not cached (or caching is disabled)
+bool loadCachedFunctions(Module *m, const std::string& analysis, FunctionsSetTy& functions);
+
+void saveCachedFunctions(Module *m, const std::string& analysis, const FunctionsSetTy& functions);
+
+// results of other analyses, one record per line (no newlines in the records)
+bool loadCachedLines(Module *m, const std::string& analysis, std::vector<std::string>& lines);
+
+void saveCachedLines(Module *m, const std::string& analysis, const std::vector<std::string>& lines);
+
+// identifies a set of functions (e.g. an input of an analysis) in analysis names, stable between runs
+std::string functionsSetId(const FunctionsSetTy& functions);
+
+#endif
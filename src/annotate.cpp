@@ -0,0 +1,287 @@
+/*
+  Annotate source files with lines found by a checking tool, e.g. lines that
+  may call into the GC (found by csfpcheck).
+
+    annotate [-n] [-c comment] [lines_file ...]
+
+  reads lines in the format "path line_number" (the output of csfpcheck and
+  sfpcheck, other lines are ignored) from the given files or from standard input and appends the
+  comment (by default a C comment with text GC) to each of these lines in
+  the source files.  Each file is rewritten only once, files are processed
+  in parallel (see RCHK_THREADS).  Lines that already end with the comment
+  are left alone, files that do not exist are silently skipped.
+
+  With -n, the files are not modified, but a patch is printed that would
+  make the same changes (in the format of "svn diff").
+*/
+
+#include <algorithm>
+#include <fcntl.h>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "parallel.h"
+
+using namespace llvm;
+
+const unsigned CONTEXT = 3; // lines of context in the patch
+
+typedef std::map<std::string, std::set<unsigned>> AnnotationsTy; // path -> line numbers
+
+// other lines are ignored, the outputs of the tools also include messages (e.g. about missing functions)
+
+static void readAnnotations(MemoryBuffer& buf, AnnotationsTy& annotations) {
+
+  StringRef rest = buf.getBuffer();
+  while(!rest.empty()) {
+    std::pair<StringRef, StringRef> split = rest.split('\n');
+    StringRef line = split.first.rtrim("\r");
+    rest = split.second;
+
+    std::pair<StringRef, StringRef> fields = line.rsplit(' ');
+    unsigned sourceLine;
+    if (fields.first.empty() || fields.first.startswith(" ") || fields.second.getAsInteger(10, sourceLine) || !sourceLine) {
+      continue;
+    }
+    annotations[fields.first.str()].insert(sourceLine);
+  }
+}
+
+// source file split into lines, without the line terminators
+
+struct SourceTy {
+  std::vector<StringRef> lines;
+  bool lastTerminated; // the last line ends with a newline
+
+  void split(StringRef text) {
+    lastTerminated = true;
+    if (text.empty()) {
+      return;
+    }
+    lastTerminated = text.back() == '\n';
+    if (lastTerminated) {
+      text = text.drop_back();
+    }
+    for(;;) {
+      std::pair<StringRef, StringRef> split = text.split('\n');
+      lines.push_back(split.first);
+      if (split.first.size() == text.size()) {
+        return; // no more newlines
+      }
+      text = split.second;
+    }
+  }
+};
+
+static std::string annotatedLine(StringRef line, const std::string& comment) {
+  StringRef cr = line.endswith("\r") ? "\r" : "";
+  return line.drop_back(cr.size()).str() + " " + comment + cr.str();
+}
+
+static void printPatchLine(raw_ostream& out, char prefix, StringRef line, bool noNewline) {
+  out << prefix << line << "\n";
+  if (noNewline) {
+    out << "\\ No newline at end of file\n";
+  }
+}
+
+// prints the changes of one file in the unified diff format, with the changed lines given by (sorted) indexes
+
+static void printPatch(raw_ostream& out, const std::string& path, const SourceTy& src, const std::vector<unsigned>& changed,
+    const std::vector<std::string>& newLines) {
+
+  out << "Index: " << path << "\n";
+  out << "===================================================================\n";
+  out << "--- " << path << "\n";
+  out << "+++ " << path << "\n";
+
+  unsigned nlines = src.lines.size();
+  unsigned ci = 0;
+  while(ci < changed.size()) {
+
+    // a hunk covers changes which have overlapping or adjacent context
+    unsigned cend = ci + 1;
+    while(cend < changed.size() && changed[cend] - changed[cend - 1] <= 2 * CONTEXT + 1) {
+      cend++;
+    }
+    unsigned first = changed[ci] > CONTEXT ? changed[ci] - CONTEXT : 0;
+    unsigned last = std::min(changed[cend - 1] + CONTEXT, nlines - 1);
+    unsigned len = last - first + 1;
+
+    out << "@@ -" << (first + 1);
+    if (len != 1) out << "," << len;
+    out << " +" << (first + 1);
+    if (len != 1) out << "," << len;
+    out << " @@\n";
+
+    unsigned k = ci;
+    for(unsigned i = first; i <= last;) {
+      bool noNewline = (i == nlines - 1) && !src.lastTerminated;
+      if (k == cend || changed[k] != i) {
+        printPatchLine(out, ' ', src.lines[i], noNewline);
+        i++;
+        continue;
+      }
+      // a block of consecutive changed lines, old lines first
+      unsigned kend = k + 1;
+      while(kend < cend && changed[kend] == changed[kend - 1] + 1) {
+        kend++;
+      }
+      for(unsigned j = k; j < kend; j++) {
+        printPatchLine(out, '-', src.lines[changed[j]], (changed[j] == nlines - 1) && !src.lastTerminated);
+      }
+      for(unsigned j = k; j < kend; j++) {
+        printPatchLine(out, '+', newLines[j], (changed[j] == nlines - 1) && !src.lastTerminated);
+      }
+      i = changed[kend - 1] + 1;
+      k = kend;
+    }
+    ci = cend;
+  }
+}
+
+static bool writeSource(const std::string& path, const SourceTy& src, const std::vector<unsigned>& changed,
+    const std::vector<std::string>& newLines, raw_ostream& msgs) {
+
+  struct stat st;
+  mode_t mode = 0666;
+  if (!stat(path.c_str(), &st)) {
+    mode = st.st_mode & 07777;
+  }
+
+  std::string tmpPath = path + ".annotate." + std::to_string(getpid());
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode);
+  if (fd < 0) {
+    msgs << "Cannot write " << tmpPath << "\n";
+    return false;
+  }
+  {
+    raw_fd_ostream out(fd, true);
+    unsigned k = 0;
+    for(unsigned i = 0, nlines = src.lines.size(); i < nlines; i++) {
+      if (k < changed.size() && changed[k] == i) {
+        out << newLines[k++];
+      } else {
+        out << src.lines[i];
+      }
+      if (i + 1 < nlines || src.lastTerminated) {
+        out << "\n";
+      }
+    }
+  }
+  if (rename(tmpPath.c_str(), path.c_str())) {
+    msgs << "Cannot replace " << path << "\n";
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+// annotates one file, the patch (dry run) and messages are written to out and msgs
+
+static bool annotateFile(const std::string& path, const std::set<unsigned>& lines, const std::string& comment, bool dryRun,
+    raw_ostream& out, raw_ostream& msgs) {
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(path);
+  if (!res) {
+    return true; // silently skip files that do not exist (anymore)
+  }
+  SourceTy src;
+  src.split(res.get()->getBuffer());
+
+  std::vector<unsigned> changed; // line indexes
+  std::vector<std::string> newLines;
+
+  for(std::set<unsigned>::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    unsigned i = *li - 1;
+    if (i >= src.lines.size()) {
+      msgs << "Line " << *li << " is beyond the end of " << path << "\n";
+      continue;
+    }
+    if (src.lines[i].rtrim("\r").endswith(comment)) {
+      continue; // already annotated
+    }
+    changed.push_back(i);
+    newLines.push_back(annotatedLine(src.lines[i], comment));
+  }
+
+  if (changed.empty()) {
+    return true;
+  }
+  if (dryRun) {
+    printPatch(out, path, src, changed, newLines);
+    return true;
+  }
+  return writeSource(path, src, changed, newLines, msgs);
+}
+
+int main(int argc, char* argv[])
+{
+  bool dryRun = false;
+  std::string comment = "/* GC */";
+  int argi = 1;
+
+  for(; argi < argc && argv[argi][0] == '-' && argv[argi][1]; argi++) {
+    if (!strcmp(argv[argi], "-n")) {
+      dryRun = true;
+    } else if (!strcmp(argv[argi], "-c") && argi + 1 < argc) {
+      comment = argv[++argi];
+    } else {
+      errs() << argv[0] << " [-n] [-c comment] [lines_file ...]\n";
+      return 2;
+    }
+  }
+
+  AnnotationsTy annotations;
+  if (argi == argc) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getSTDIN();
+    if (!res) {
+      errs() << "Cannot read standard input: " << res.getError().message() << "\n";
+      return 2;
+    }
+    readAnnotations(*res.get(), annotations);
+  }
+  for(; argi < argc; argi++) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(argv[argi]);
+    if (!res) {
+      errs() << "Cannot read " << argv[argi] << ": " << res.getError().message() << "\n";
+      return 2;
+    }
+    readAnnotations(*res.get(), annotations);
+  }
+
+  // files are processed concurrently, the outputs are printed in the order of paths
+  std::vector<AnnotationsTy::const_iterator> files;
+  for(AnnotationsTy::const_iterator ai = annotations.begin(), ae = annotations.end(); ai != ae; ++ai) {
+    files.push_back(ai);
+  }
+  unsigned nfiles = files.size();
+  std::vector<std::string> outputs(nfiles);
+  std::vector<std::string> messages(nfiles);
+  std::vector<char> failed(nfiles, false);
+
+  parallelFor(nfiles, [&](unsigned fi) {
+    raw_string_ostream out(outputs[fi]);
+    raw_string_ostream msgs(messages[fi]);
+    failed[fi] = !annotateFile(files[fi]->first, files[fi]->second, comment, dryRun, out, msgs);
+  });
+
+  bool ok = true;
+  for(unsigned fi = 0; fi < nfiles; fi++) {
+    outs() << outputs[fi];
+    errs() << messages[fi];
+    ok = ok && !failed[fi];
+  }
+  return ok ? 0 : 1;
+}
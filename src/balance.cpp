@@ -1,5 +1,6 @@
 
 #include "balance.h"
+#include "counters.h"
 
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Constants.h>
@@ -20,6 +21,10 @@ const std::string CONFUSION_DISCLAIMER = QUIET_WHEN_CONFUSED ? "results will be
 
 using namespace llvm;
 
+static CounterTy callsCounter("balance handleCall");
+static CounterTy loadsCounter("balance handleLoad");
+static CounterTy storesCounter("balance handleStore");
+
 // protection stack top "save variable" is a local variable
 //   - which can be assigned the value of R_PPStackTop (typically at start of function)
 //   - which can be assigned to R_PPStackTop (typically at end of function)
@@ -164,6 +169,7 @@ bool isProtectionCounterVariable(AllocaInst* var, Function* unprotectFunction, V
 }
 
 static void handleCall(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& counterVarsCache, LineMessenger& msg, unsigned& refinableInfos) {
+  callsCounter.inc();
   
   CallSite cs(cast<Value>(in));
   if (!cs) {
@@ -299,6 +305,7 @@ static void handleCall(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBool
 }
 
 static void handleLoad(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& saveVarsCache, LineMessenger& msg, unsigned& refinableInfos) {
+  loadsCounter.inc();
 
   if (!LoadInst::classof(in)) {
     return;
@@ -335,6 +342,7 @@ static void handleLoad(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBool
 
 static void handleStore(Instruction *in, BalanceStateTy& b, GlobalsTy& g, VarBoolCacheTy& saveVarsCache, VarBoolCacheTy& counterVarsCache,
     LineMessenger& msg, unsigned& refinableInfos) {
+  storesCounter.inc();
     
   if (!StoreInst::classof(in)) {
     return;
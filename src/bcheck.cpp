@@ -16,6 +16,8 @@
 
 #include "common.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <map>
 #include <set>
 #include <stack>
@@ -40,6 +42,12 @@
 #include "symbols.h"
 #include "exceptions.h"
 #include "liveness.h"
+#include "dataflow.h"
+#include "deadline.h"
+#include "profile.h"
+#include "counters.h"
+#include "checkpoint.h"
+#include "bdd.h"
 
 using namespace llvm;
 
@@ -67,6 +75,12 @@ const bool FULL_COMPARISON = true;
   //   (some states will not be checked)
   //   yet there may be some speedups in some cases
 
+const bool SYMBOLIC_GUARDS = getenv("RCHK_SYMBOLIC_GUARDS") != NULL;
+  // keep the guards of visited states symbolically
+  //   for each state without guards, the valuations of guards seen with it are kept
+  //   in a BDD instead of as explicit states, which takes much less memory in functions
+  //   with many independent guards; the states explored are the same
+
 const bool USE_ALLOCATOR_DETECTION = true;
   // use allocator detection to set SEXP guard variables to non-nill on allocation
   // this is optional, because it is not correct
@@ -92,6 +106,11 @@ const int MAX_STATES = BCHECK_MAX_STATES;        // maximum number of states vis
 unsigned int nComparedEqual = 0;
 unsigned int nComparedDifferent = 0;
 
+static CounterTy clonesCounter("bcheck clones");
+static CounterTy comparedEqualCounter("bcheck compared equal");
+static CounterTy comparedDifferentCounter("bcheck compared different");
+static CounterTy doneSetCollisionsCounter("bcheck doneset collisions");
+
 struct BcheckStateTy : public StateWithGuardsTy, StateWithFreshVarsTy, StateWithBalanceTy {
   
   size_t hashcode;
@@ -103,6 +122,7 @@ struct BcheckStateTy : public StateWithGuardsTy, StateWithFreshVarsTy, StateWith
       StateBaseTy(bb), StateWithGuardsTy(bb, intGuards, sexpGuards), StateWithFreshVarsTy(bb, freshVars), StateWithBalanceTy(bb, balance), hashcode(0) {};
       
     virtual BcheckStateTy* clone(BasicBlock *newBB) {
+      clonesCounter.inc();
       return new BcheckStateTy(newBB, balance, intGuards, sexpGuards, freshVars);
     }
     
@@ -115,32 +135,16 @@ struct BcheckStateTy : public StateWithGuardsTy, StateWithFreshVarsTy, StateWith
       hash_combine(res, balance.savedDepth);
       // not including topSaveVar
       hash_combine(res, (int) balance.countState);
-      hash_combine(res, intGuards.size());
-      for(IntGuardsTy::const_iterator gi = intGuards.begin(), ge = intGuards.end(); gi != ge; ++gi) {
-        AllocaInst* var = gi->first;
-        IntGuardState s = gi->second;
-        hash_combine(res, (void *)var);
-        hash_combine(res, (char) s);
-      } // ordered map
-
-      hash_combine(res, sexpGuards.size());
-      for(SEXPGuardsTy::const_iterator gi = sexpGuards.begin(), ge = sexpGuards.end(); gi != ge; ++gi) {
-        AllocaInst* var = gi->first;
-        const SEXPGuardTy& g = gi->second;
-        hash_combine(res, (void *) var);
-        hash_combine(res, (char) g.state);
-        if (g.state == SGS_SYMBOL) {
-          hash_combine(res, g.symbolName);
-        }
-      } // ordered map
-
+      
+      // guards, fresh variables and the protect stack maintain their hashes incrementally
+      if (!SYMBOLIC_GUARDS) { // with symbolic guards, states only differing in guards are in the same entry
+        hash_combine(res, intGuards.size());
+        hash_combine(res, intGuards.hash());
+        hash_combine(res, sexpGuards.size());
+        hash_combine(res, sexpGuards.hash());
+      }
       hash_combine(res, freshVars.vars.size());
-      for(FreshVarsVarsTy::iterator fi = freshVars.vars.begin(), fe = freshVars.vars.end(); fi != fe; ++fi) {
-        AllocaInst* in = fi->first;
-        int pcount = fi->second;
-        hash_combine(res, (void *) in);
-        hash_combine(res, pcount);
-      } // ordered set
+      hash_combine(res, freshVars.vars.hash());
 
       hash_combine(res, freshVars.condMsgs.size());
       for(ConditionalMessagesTy::iterator mi = freshVars.condMsgs.begin(), me = freshVars.condMsgs.end(); mi != me; ++mi) {
@@ -154,10 +158,7 @@ struct BcheckStateTy : public StateWithGuardsTy, StateWithFreshVarsTy, StateWith
       } // condMsgs is unordered
 
       hash_combine(res, freshVars.pstack.size());
-      for(VarsVectorTy::iterator vi = freshVars.pstack.begin(), ve = freshVars.pstack.end(); vi != ve; ++vi) {
-        AllocaInst* var = *vi;
-        hash_combine(res, (void *) var);
-      }
+      hash_combine(res, freshVars.pstack.hash());
       hashcode = res;
     }
 
@@ -183,7 +184,7 @@ struct BcheckStateTy_hash {
   }
 };
 
-struct BcheckStateTy_equal {
+template<bool withGuards> struct BcheckStateTy_equalTy {
   bool operator() (const BcheckStateTy* lhs, const BcheckStateTy* rhs) const {
 
     if (!FULL_COMPARISON) {
@@ -200,11 +201,16 @@ struct BcheckStateTy_equal {
       lhs->balance.depth == rhs->balance.depth && lhs->balance.savedDepth == rhs->balance.savedDepth && lhs->balance.count == rhs->balance.count &&
       lhs->balance.countState == rhs->balance.countState && lhs->balance.counterVar == rhs->balance.counterVar && lhs->balance.confused == rhs->balance.confused &&
       lhs->balance.topSaveVar == rhs->balance.topSaveVar &&
-      lhs->intGuards == rhs->intGuards && lhs->sexpGuards == rhs->sexpGuards &&
+      (!withGuards || (lhs->intGuards == rhs->intGuards && lhs->sexpGuards == rhs->sexpGuards)) &&
       lhs->freshVars.vars == rhs->freshVars.vars && lhs->freshVars.condMsgs == rhs->freshVars.condMsgs && lhs->freshVars.pstack == rhs->freshVars.pstack
          && lhs->freshVars.confused == rhs->freshVars.confused;
     }
     
+    if (res) {
+      comparedEqualCounter.inc();
+    } else {
+      comparedDifferentCounter.inc();
+    }
     if (PROGRESS_MARKS) {
       if (res) {
         nComparedEqual++;
@@ -216,18 +222,53 @@ struct BcheckStateTy_equal {
   }
 };
 
+typedef BcheckStateTy_equalTy<true> BcheckStateTy_equal;
+typedef BcheckStateTy_equalTy<false> BcheckStateTy_equalWithoutGuards;
+
 typedef std::stack<BcheckStateTy*> WorkListTy;
 typedef std::unordered_set<BcheckStateTy*, BcheckStateTy_hash, BcheckStateTy_equal> DoneSetTy;
+typedef std::unordered_map<BcheckStateTy*, BddTy::NodeTy, BcheckStateTy_hash, BcheckStateTy_equalWithoutGuards> SymbolicDoneSetTy;
+  // state without guards -> set of guard valuations seen with it
 
 // ------------- helper functions --------------
 
 DoneSetTy doneSet;
 WorkListTy workList;   
 
+SymbolicDoneSetTy symbolicDoneSet; // used instead of doneSet with symbolic guards
+BddTy guardSets;
+GuardsEncoderTy guardsEncoder;
+unsigned long symbolicStates = 0;
+
+unsigned long doneStates() {
+  return SYMBOLIC_GUARDS ? symbolicStates : doneSet.size();
+}
+
+// with symbolic guards, the states on the worklist are not kept in the done set, they
+// are deleted once processed
+
+static bool addGuardValuation(BcheckStateTy *s) {
+  PackedBitsTy bits = guardsEncoder.encode(*s);
+
+  auto dsearch = symbolicDoneSet.find(s);
+  if (dsearch == symbolicDoneSet.end()) {
+    BcheckStateTy *key = new BcheckStateTy(*s);
+    key->intGuards.clear();
+    key->sexpGuards.clear();
+    key->hash();
+    dsearch = symbolicDoneSet.insert({key, BddTy::EMPTY}).first;
+  } else if (guardSets.contains(dsearch->second, bits)) {
+    return false;
+  }
+  dsearch->second = guardSets.insert(dsearch->second, bits);
+  symbolicStates++;
+  return true;
+}
+
 bool BcheckStateTy::add() {
   hash(); // precompute hashcode
-  auto sinsert = doneSet.insert(this);
-  if (sinsert.second) {
+  bool added = SYMBOLIC_GUARDS ? addGuardValuation(this) : doneSet.insert(this).second;
+  if (added) {
     workList.push(this);
     if (DUMP_STATES && (DUMP_STATES_FUNCTION.empty() || DUMP_STATES_FUNCTION == bb->getParent()->getName())) {
       outs().flush();
@@ -236,24 +277,241 @@ bool BcheckStateTy::add() {
     }
     return true;
   } else {
+    doneSetCollisionsCounter.inc();
     delete this; // NOTE: state suicide
     return false;
   }
 }
 
 unsigned long totalStates = 0;
+unsigned long lastStates = 0; // number of states when last cleared
 
 void clearStates() {
   // clear the worklist and the doneset
-  totalStates += doneSet.size();
+  totalStates += doneStates();
+  lastStates = doneStates();
   for(DoneSetTy::iterator ds = doneSet.begin(), de = doneSet.end(); ds != de; ++ds) {
     BcheckStateTy *old = *ds;
     delete old;
   }
   doneSet.clear();
+  if (SYMBOLIC_GUARDS) {
+    for(SymbolicDoneSetTy::iterator ds = symbolicDoneSet.begin(), de = symbolicDoneSet.end(); ds != de; ++ds) {
+      delete ds->first;
+    }
+    symbolicDoneSet.clear();
+    guardSets.clear();
+    symbolicStates = 0;
+    for(; !workList.empty(); workList.pop()) {
+      delete workList.top();
+    }
+  }
   WorkListTy empty;
   std::swap(workList, empty);
-  // all elements in worklist are also in doneset, so no need to call destructors
+  // without symbolic guards, all elements in worklist are also in doneset, so no need to call destructors
+}
+
+// ------------- state explosion diagnostics --------------
+
+// when environment variable RCHK_STATE_DIAGNOSTICS is set, functions that hit the states limit
+// are reported with the number of distinct values of each state component and of each guard
+// and fresh variable seen in the explored states, with the blocks that have the most states,
+// and with the number of states in each checking phase (guards are enabled in phases)
+//
+// when RCHK_STATE_DIAGNOSTICS is set to a number, also functions where a checking phase
+// completes with at least that many states are reported
+
+const unsigned DIAG_MAX_ITEMS = 10; // max variables of each kind and blocks to report
+
+bool stateDiagnostics(unsigned long& threshold) {
+  static int enabled = -1;
+  static unsigned long minStates = 0;
+  
+  if (enabled < 0) {
+    const char *env = getenv("RCHK_STATE_DIAGNOSTICS");
+    enabled = env != NULL;
+    if (env) {
+      long n = atol(env);
+      minStates = (n > 0) ? n : 0;
+    }
+  }
+  threshold = minStates;
+  return enabled;
+}
+
+struct PhaseStatesTy {
+  std::string name;
+  unsigned long states;
+  std::string result;
+};
+
+typedef std::vector<PhaseStatesTy> PhasesTy;
+
+std::string phaseName(bool intGuardsEnabled, bool sexpGuardsEnabled) {
+  if (intGuardsEnabled && sexpGuardsEnabled) {
+    return "int and sexp guards";
+  }
+  if (intGuardsEnabled) {
+    return "int guards";
+  }
+  if (sexpGuardsEnabled) {
+    return "sexp guards";
+  }
+  return "no guards";
+}
+
+// distinct values are counted by hashes of the values, which is precise enough for diagnostics
+
+typedef std::unordered_set<size_t> ValueHashesTy;
+
+struct VarValuesTy {
+  ValueHashesTy values;
+  unsigned long nstates; // number of states in which the variable is present
+  
+  VarValuesTy(): values(), nstates(0) {}
+  
+  void add(size_t value) {
+    values.insert(value);
+    nstates++;
+  }
+  
+  unsigned long distinct(unsigned long totalStates) const {
+    return values.size() + (nstates < totalStates ? 1 : 0); // absence is a value, too
+  }
+};
+
+typedef std::map<AllocaInst*, VarValuesTy> VarsValuesTy;
+
+void printVarsValues(const std::string& kind, const VarsValuesTy& vars, unsigned long totalStates) {
+  std::vector<std::pair<unsigned long, AllocaInst*>> sorted;
+  for(VarsValuesTy::const_iterator vi = vars.begin(), ve = vars.end(); vi != ve; ++vi) {
+    unsigned long n = vi->second.distinct(totalStates);
+    if (n > 1) {
+      sorted.push_back({n, vi->first});
+    }
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<unsigned long, AllocaInst*>& a, const std::pair<unsigned long, AllocaInst*>& b) {
+    return a.first > b.first;
+  });
+  for(unsigned i = 0; i < sorted.size() && i < DIAG_MAX_ITEMS; i++) {
+    errs() << "  " << kind << " " << varName(sorted[i].second) << ": " << sorted[i].first << " values\n";
+  }
+}
+
+void printStateDiagnostics(Function *fun, const std::string& checksName, const PhasesTy& phases) {
+
+  unsigned long nstates = doneStates();
+  ValueHashesTy balanceValues, intGuardsValues, sexpGuardsValues, freshVarsValues, condMsgsValues, pstackValues;
+  VarsValuesTy intGuardVars, sexpGuardVars, freshVarVars;
+  std::unordered_map<BasicBlock*, unsigned long> blockStates;
+  
+  // with symbolic guards, only states without guards are available
+  std::vector<BcheckStateTy*> states;
+  for(DoneSetTy::iterator si = doneSet.begin(), se = doneSet.end(); si != se; ++si) {
+    states.push_back(*si);
+  }
+  for(SymbolicDoneSetTy::iterator si = symbolicDoneSet.begin(), se = symbolicDoneSet.end(); si != se; ++si) {
+    states.push_back(si->first);
+  }
+
+  for(std::vector<BcheckStateTy*>::iterator si = states.begin(), se = states.end(); si != se; ++si) {
+    BcheckStateTy& s = **si;
+    blockStates[s.bb]++;
+    
+    size_t h = 0;
+    hash_combine(h, s.balance.depth);
+    hash_combine(h, s.balance.savedDepth);
+    hash_combine(h, s.balance.count);
+    hash_combine(h, (int) s.balance.countState);
+    hash_combine(h, (void *) s.balance.counterVar);
+    hash_combine(h, (void *) s.balance.topSaveVar);
+    hash_combine(h, s.balance.confused);
+    balanceValues.insert(h);
+    
+    h = 0;
+    for(IntGuardsTy::const_iterator gi = s.intGuards.begin(), ge = s.intGuards.end(); gi != ge; ++gi) {
+      hash_combine(h, (void *) gi->first);
+      hash_combine(h, (char) gi->second);
+      intGuardVars[gi->first].add(gi->second);
+    }
+    intGuardsValues.insert(h);
+
+    h = 0;
+    for(SEXPGuardsTy::const_iterator gi = s.sexpGuards.begin(), ge = s.sexpGuards.end(); gi != ge; ++gi) {
+      size_t gh = 0;
+      hash_combine(gh, (char) gi->second.state);
+      if (gi->second.state == SGS_SYMBOL) {
+        hash_combine(gh, gi->second.symbolName);
+      }
+      hash_combine(h, (void *) gi->first);
+      hash_combine(h, gh);
+      sexpGuardVars[gi->first].add(gh);
+    }
+    sexpGuardsValues.insert(h);
+    
+    h = 0;
+    for(FreshVarsVarsTy::const_iterator fi = s.freshVars.vars.begin(), fe = s.freshVars.vars.end(); fi != fe; ++fi) {
+      hash_combine(h, (void *) fi->first);
+      hash_combine(h, fi->second);
+      freshVarVars[fi->first].add(fi->second);
+    }
+    hash_combine(h, s.freshVars.confused);
+    freshVarsValues.insert(h);
+    
+    h = 0;
+    for(ConditionalMessagesTy::iterator mi = s.freshVars.condMsgs.begin(), me = s.freshVars.condMsgs.end(); mi != me; ++mi) {
+      hash_combine(h, (void *) mi->first);
+      for(LineInfoPtrSetTy::const_iterator li = mi->second.delayedLineBuffer.begin(), le = mi->second.delayedLineBuffer.end(); li != le; ++li) {
+        hash_combine(h, (const void *) *li);
+      }
+    }
+    condMsgsValues.insert(h);
+    
+    h = 0;
+    for(PStackTy::const_iterator vi = s.freshVars.pstack.begin(), ve = s.freshVars.pstack.end(); vi != ve; ++vi) {
+      hash_combine(h, (void *) *vi);
+    }
+    pstackValues.insert(h);
+  }
+  
+  outs().flush();
+  errs() << "State diagnostics for function " << funName(fun) << checksName << ": " << nstates << " states\n";
+  errs() << "  phases:";
+  for(PhasesTy::const_iterator pi = phases.begin(), pe = phases.end(); pi != pe; ++pi) {
+    errs() << (pi == phases.begin() ? " " : ", ") << pi->name << " " << pi->states << " states (" << pi->result << ")";
+  }
+  errs() << "\n";
+  if (SYMBOLIC_GUARDS) {
+    errs() << "  symbolic guards: " << symbolicDoneSet.size() << " states without guards, " << guardSets.size() << " BDD nodes\n";
+  }
+  errs() << "  distinct values: balance " << balanceValues.size();
+  if (SYMBOLIC_GUARDS) {
+    // the guards are only kept in BDDs, the states have them cleared
+    errs() << ", int guards n/a, sexp guards n/a";
+  } else {
+    errs() << ", int guards " << intGuardsValues.size() << ", sexp guards " << sexpGuardsValues.size();
+  }
+  errs() << ", fresh vars " << freshVarsValues.size() <<
+    ", conditional messages " << condMsgsValues.size() << ", protection stack " << pstackValues.size() << "\n";
+  
+  if (SYMBOLIC_GUARDS) {
+    errs() << "  guard values are not available with symbolic guards\n";
+  } else {
+    printVarsValues("int guard", intGuardVars, nstates);
+    printVarsValues("sexp guard", sexpGuardVars, nstates);
+  }
+  printVarsValues("fresh variable", freshVarVars, nstates);
+  
+  std::vector<std::pair<unsigned long, BasicBlock*>> blocks;
+  for(auto bi = blockStates.begin(), be = blockStates.end(); bi != be; ++bi) {
+    blocks.push_back({bi->second, bi->first});
+  }
+  std::sort(blocks.begin(), blocks.end(), [](const std::pair<unsigned long, BasicBlock*>& a, const std::pair<unsigned long, BasicBlock*>& b) {
+    return a.first > b.first;
+  });
+  for(unsigned i = 0; i < blocks.size() && i < DIAG_MAX_ITEMS; i++) {
+    errs() << "  block with " << blocks[i].first << " states at " << sourceLocation(&*blocks[i].second->begin()) << "\n";
+  }
 }
 
 void handleUnprotectWithIntGuard(Instruction *in, BcheckStateTy& s, GlobalsTy& g, IntGuardsChecker& intGuardsChecker, LineMessenger& msg, unsigned& refinableInfos) { 
@@ -331,10 +589,13 @@ struct ModuleCheckingStateTy {
   LineMessenger& msg;
   CalledModuleTy& cm;
   CProtectInfo& cprotect;
+  PrecisionProfileTy& profile;
+  CheckpointTy& checkpoint;
   
   ModuleCheckingStateTy(FunctionsSetTy& possibleAllocators, FunctionsSetTy& allocatingFunctions, FunctionsSetTy& errorFunctions,
-      GlobalsTy& gl, LineMessenger& msg, CalledModuleTy& cm, CProtectInfo& cprotect):
-    possibleAllocators(possibleAllocators), allocatingFunctions(allocatingFunctions), errorFunctions(errorFunctions), gl(gl), msg(msg), cm(cm), cprotect(cprotect) {};
+      GlobalsTy& gl, LineMessenger& msg, CalledModuleTy& cm, CProtectInfo& cprotect, PrecisionProfileTy& profile, CheckpointTy& checkpoint):
+    possibleAllocators(possibleAllocators), allocatingFunctions(allocatingFunctions), errorFunctions(errorFunctions), gl(gl), msg(msg), cm(cm), cprotect(cprotect),
+    profile(profile), checkpoint(checkpoint) {};
 };
 
 class FunctionChecker {
@@ -349,12 +610,30 @@ class FunctionChecker {
   LiveVarsTy liveVars;
 
   ModuleCheckingStateTy& m;
+  
+  std::string checksName;
+  PhasesTy phases; // for state explosion diagnostics
+  
+  bool avoidIntGuards; // hard-coded (exceptions) or learned (profile)
+  bool avoidSEXPGuards;
+  bool limitReached;
+  DeadlineTy deadline;
+  bool timedOut;
+
+  void printError(const std::string& text) { // kept in the checkpoint, so that it is printed again on resume
+    errs() << text << "\n";
+    m.checkpoint.recordError(text);
+  }
 
   void checkFunction(bool intGuardsEnabled, bool sexpGuardsEnabled, bool balanceCheckingEnabled, bool freshVarsCheckingEnabled, unsigned& refinableInfos) {
   
     refinableInfos = 0;
-    bool restartable = (!intGuardsEnabled && !avoidIntGuardsFor(fun)) || (!sexpGuardsEnabled && !avoidSEXPGuardsFor(fun));
+    limitReached = false;
+    bool restartable = (!intGuardsEnabled && !avoidIntGuards) || (!sexpGuardsEnabled && !avoidSEXPGuards);
     clearStates();
+    if (SYMBOLIC_GUARDS) {
+      guardsEncoder.reset(fun, intGuardsChecker, sexpGuardsChecker);
+    }
     {
       BcheckStateTy* initState = new BcheckStateTy(&fun->getEntryBlock());
       initState->add();
@@ -376,8 +655,12 @@ class FunctionChecker {
         workList.top()->dump();
       }
 
-      BcheckStateTy s(*workList.top());
+      BcheckStateTy* top = workList.top();
+      BcheckStateTy s(*top);
       workList.pop();
+      if (SYMBOLIC_GUARDS) {
+        delete top;
+      }
       m.msg.trace("going to work on this state:", &*s.bb->begin());
       
       if (errorBasicBlocks.find(s.bb) != errorBasicBlocks.end()) {
@@ -385,16 +668,30 @@ class FunctionChecker {
         continue;
       }
       
-      if (doneSet.size() > MAX_STATES) {
-        errs() << "ERROR: too many states (abstraction error?) in function " << funName(fun) << "\n";
+      if (doneStates() > MAX_STATES) {
+        printError("ERROR: too many states (abstraction error?) in function " + funName(fun));
+        unsigned long threshold;
+        if (stateDiagnostics(threshold)) {
+          phases.push_back({phaseName(intGuardsEnabled, sexpGuardsEnabled), doneStates(), "limit reached"});
+          printStateDiagnostics(fun, checksName, phases);
+        }
+        limitReached = true;
+        clearStates();
+        return;
+      }
+
+      if (deadline.expired()) {
+        printError("ERROR: time budget exhausted in function " + funName(fun));
+        recordTimeout(fun, "bcheck" + checksName, deadline.elapsed());
+        timedOut = true;
         clearStates();
         return;
       }
       
       if (PROGRESS_MARKS) {
-        if (doneSet.size() % PROGRESS_STEP == 0) {
+        if (doneStates() % PROGRESS_STEP == 0) {
           errs() << "current worklist:" << std::to_string(workList.size()) << " current function:" << funName(fun) <<
-            " done:" << std::to_string(doneSet.size()) << " equal:" << nComparedEqual << " different:" << nComparedDifferent << "\n";
+            " done:" << std::to_string(doneStates()) << " equal:" << nComparedEqual << " different:" << nComparedDifferent << "\n";
         }
       }      
       
@@ -472,42 +769,119 @@ class FunctionChecker {
         /* TODO: we would need "sure" allocators here instead of possible allocators! */
         sexpGuardsChecker(&moduleState.msg, &moduleState.gl, 
           USE_ALLOCATOR_DETECTION ? moduleState.cm.getContextSensitivePossibleAllocators() : NULL, moduleState.cm.getSymbolsMap(), NULL, moduleState.cm.getVrfState(), &moduleState.cm),
-        errorBasicBlocks(), m(moduleState) {
+        errorBasicBlocks(), m(moduleState), checksName(), phases(), avoidIntGuards(false), avoidSEXPGuards(false), limitReached(false),
+        deadline(), timedOut(false) {
         
       findErrorBasicBlocks(fun, &m.errorFunctions, errorBasicBlocks);
       liveVars = findLiveVariables(fun);
     }  
   
+    bool hasTimedOut() const { return timedOut; }
+
     // handles restarts
     void checkFunction(bool balanceCheckingEnabled, bool freshVarsCheckingEnabled, std::string checksName) {
 
       m.msg.newFunction(fun, checksName);
+      this->checksName = checksName;
+      phases.clear();
       bool intGuardsEnabled = false;
       bool sexpGuardsEnabled = false;
       unsigned refinableInfos;
+      
+      avoidIntGuards = avoidIntGuardsFor(fun);
+      avoidSEXPGuards = avoidSEXPGuardsFor(fun);
+      
+      // start with the precision known to be needed, avoid guards known to explode
+      const FunctionProfileTy* known = m.profile.lookup(fun, checksName);
+      if (known && known->result == PR_EXPLODED) {
+        known = NULL; // checked again from scratch, its callees may have changed
+      }
+      if (known) {
+        avoidIntGuards = avoidIntGuards || known->avoidIntGuards;
+        avoidSEXPGuards = avoidSEXPGuards || known->avoidSEXPGuards;
+        intGuardsEnabled = known->intGuards && !avoidIntGuards;
+        sexpGuardsEnabled = known->sexpGuards && !avoidSEXPGuards;
+      }
+      unsigned long threshold;
+      bool diagnostics = stateDiagnostics(threshold);
+      deadline.startFunction();
+      timedOut = false;
     
       for(;;) {
+        unsigned nphases = phases.size();
         checkFunction(intGuardsEnabled, sexpGuardsEnabled, balanceCheckingEnabled, freshVarsCheckingEnabled, refinableInfos);
     
-        bool restartable = (!intGuardsEnabled && !avoidIntGuardsFor(fun)) || (!sexpGuardsEnabled && !avoidSEXPGuardsFor(fun));
+        bool restartable = (!intGuardsEnabled && !avoidIntGuards) || (!sexpGuardsEnabled && !avoidSEXPGuards);
+        if (diagnostics && phases.size() == nphases) { // not reported yet
+          if (doneStates()) {
+            phases.push_back({phaseName(intGuardsEnabled, sexpGuardsEnabled), doneStates(), "completed"});
+            if (threshold && doneStates() >= threshold) {
+              printStateDiagnostics(fun, checksName, phases);
+            }
+          } else {
+            phases.push_back({phaseName(intGuardsEnabled, sexpGuardsEnabled), lastStates, "restarted"});
+          }
+        }
         if (restartable && refinableInfos>0) {
           // retry with more precise checking
           m.msg.clear();
-          if (!intGuardsEnabled && !avoidIntGuardsFor(fun)) {
+          if (!intGuardsEnabled && !avoidIntGuards) {
             intGuardsEnabled = true;
-          } else if (!sexpGuardsEnabled && !avoidSEXPGuardsFor(fun)) {
+          } else if (!sexpGuardsEnabled && !avoidSEXPGuards) {
             sexpGuardsEnabled = true;
           }
         } else {
           break;
         }
       }
+      
+      if (timedOut) {
+        return; // says nothing about the precision needed
+      }
+      FunctionProfileTy p;
+      p.avoidIntGuards = known && known->avoidIntGuards;
+      p.avoidSEXPGuards = known && known->avoidSEXPGuards;
+      if (!limitReached) {
+        p.intGuards = intGuardsEnabled;
+        p.sexpGuards = sexpGuardsEnabled;
+        p.states = doneStates();
+        p.result = PR_COMPLETED;
+      } else {
+        // next time, avoid the guards enabled last
+        p.states = lastStates;
+        p.result = PR_GUARDS_EXPLODED;
+        if (sexpGuardsEnabled) {
+          p.avoidSEXPGuards = true;
+          p.intGuards = intGuardsEnabled;
+        } else if (intGuardsEnabled) {
+          p.avoidIntGuards = true;
+        } else {
+          p.result = PR_EXPLODED;
+        }
+      }
+      m.profile.record(fun, checksName, p);
     }
 };
 
 
 // -------------------------------- main  -----------------------------------
 
+static bool isToBeChecked(Function *fun, GlobalsTy& gl) {
+
+  if (!fun || !fun->size()) {
+    return false;
+  }
+  if (EXCLUDE_PROTECTION_FUNCTIONS &&
+    (fun == gl.protectFunction ||
+    fun == gl.protectWithIndexFunction ||
+    fun == gl.unprotectFunction ||
+    fun == gl.unprotectPtrFunction)) {
+    
+    return false;
+  }
+  return true;
+}
+
 int main(int argc, char* argv[])
 {
   LLVMContext context;
@@ -518,6 +892,15 @@ int main(int argc, char* argv[])
 //  EXCLUDE_PROTECTION_FUNCTIONS = (argc == 3); // exclude when checking modules
   GlobalsTy gl(m);
   LineMessenger msg(context, DEBUG, TRACE, UNIQUE_MSG);
+  {
+    unsigned nfunctions = 0;
+    for(FunctionsVectorTy::iterator FI = functionsOfInterestVector.begin(), FE = functionsOfInterestVector.end(); FI != FE; ++FI) {
+      if (isToBeChecked(*FI, gl)) {
+        nfunctions++;
+      }
+    }
+    msg.startReport(nfunctions); // before the module analyses, so that the progress can be watched from the start
+  }
   
   FunctionsSetTy errorFunctions;
   findErrorFunctions(m, errorFunctions);
@@ -534,41 +917,71 @@ int main(int argc, char* argv[])
   CalledModuleTy cm(m, &symbolsMap, &errorFunctions, &gl, &possibleAllocators, &allocatingFunctions);
   CProtectInfo cprotect = findCalleeProtectFunctions(m, *cm.getContextSensitiveAllocatingFunctions());
   
-  ModuleCheckingStateTy mstate(possibleAllocators, allocatingFunctions, errorFunctions, gl, msg, cm, cprotect); 
+  PrecisionProfileTy profile(MAX_STATES);
+  CheckpointTy checkpoint(m, "bcheck");
+  if (checkpoint.enabled()) {
+    msg.setLinesHandler([&checkpoint](Function *, const std::string& checksName, const std::vector<const LineInfoTy*>& lines) {
+      checkpoint.recordMessages(checksName, lines);
+    });
+  }
+  ModuleCheckingStateTy mstate(possibleAllocators, allocatingFunctions, errorFunctions, gl, msg, cm, cprotect, profile, checkpoint); 
     // FIXME: perhaps get rid of ModuleCheckingState now that we have CalledModule
 
   unsigned nAnalyzedFunctions = 0;
   for(FunctionsVectorTy::iterator FI = functionsOfInterestVector.begin(), FE = functionsOfInterestVector.end(); FI != FE; ++FI) {
     Function *fun = *FI;
 
-    if (!fun) continue;
-    if (!fun->size()) continue;
-    
-    if (EXCLUDE_PROTECTION_FUNCTIONS &&
-      (fun == gl.protectFunction ||
-      fun == gl.protectWithIndexFunction ||
-      fun == gl.unprotectFunction ||
-      fun == gl.unprotectPtrFunction)) {
-      
-      continue;
+    if (moduleDeadlineExpired()) {
+      errs() << "ERROR: time budget of the module exhausted, remaining functions not checked\n";
+      recordModuleTimeout(FE - FI);
+      break;
     }
+
+    if (!isToBeChecked(fun, gl)) continue;
     
     nAnalyzedFunctions++;
+
+    const CheckpointFunctionTy* done = checkpoint.lookup(fun);
+    if (done) {
+      checkpoint.replay(fun, *done, msg);
+      totalStates += done->states;
+      continue;
+    }
+
     FunctionChecker fchk(fun, mstate);
+    unsigned long statesBefore = totalStates + doneStates(); // states of the last phase are only counted when cleared
+    bool timedOut = false;
 
+    startFunctionCounters();
+    checkpoint.startFunction();
     if (SEPARATE_CHECKING) {
         // FIXME: it would make more sense to only print prefixes [BP] and [UP] with join checking
       fchk.checkFunction(true, false, " [protection balance]");
+      timedOut = fchk.hasTimedOut();
       fchk.checkFunction(false, true, " [unprotected pointers]");
     } else {
       fchk.checkFunction(true, true, "");  
     }
+    timedOut = timedOut || fchk.hasTimedOut();
+    if (checkpoint.enabled()) {
+      msg.flush(); // so that the messages are recorded with the function
+      if (!timedOut) { // may complete when resumed
+        checkpoint.endFunction(fun, totalStates + doneStates() - statesBefore);
+      }
+    }
+    printFunctionCounters(funName(fun));
   }
   msg.flush();
+  checkpoint.save();
+  msg.endReport();
   clearStates();
+  profile.save();
   delete m;
 
   outs().flush();
   errs() << "Analyzed " << nAnalyzedFunctions << " functions, traversed " << totalStates << " states.\n";
+  printDataflowStats();
+  printTimeouts();
+  printCounters();
   return 0;
 }
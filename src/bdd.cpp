@@ -0,0 +1,55 @@
+
+#include "bdd.h"
+
+const unsigned TERMINAL_VAR = ~0U; // terminals are below all variables
+
+void BddTy::clear() {
+  nodes.clear();
+  unique.clear();
+  nodes.push_back({TERMINAL_VAR, EMPTY, EMPTY});
+  nodes.push_back({TERMINAL_VAR, FULL, FULL});
+}
+
+BddTy::NodeTy BddTy::make(unsigned var, NodeTy low, NodeTy high) {
+
+  if (low == high) {
+    return low; // the variable does not matter
+  }
+  NodeEntryTy n = {var, low, high};
+  auto uinsert = unique.insert({n, (NodeTy) nodes.size()});
+  if (uinsert.second) {
+    nodes.push_back(n);
+  }
+  return uinsert.first->second;
+}
+
+// the union of set and the single vector bits, for variables var and above
+
+BddTy::NodeTy BddTy::insert(NodeTy set, const PackedBitsTy& bits, unsigned var) {
+
+  if (set == FULL || var == bits.size()) {
+    return FULL;
+  }
+  NodeTy low = set;
+  NodeTy high = set;
+  if (nodes[set].var == var) {
+    low = nodes[set].low;
+    high = nodes[set].high;
+  } // otherwise the set does not depend on var
+
+  if (bits.getField(var, 1)) {
+    high = insert(high, bits, var + 1);
+  } else {
+    low = insert(low, bits, var + 1);
+  }
+  return make(var, low, high);
+}
+
+bool BddTy::contains(NodeTy set, const PackedBitsTy& bits) const {
+
+  while(set != EMPTY && set != FULL) {
+    const NodeEntryTy& n = nodes[set];
+    set = bits.getField(n.var, 1) ? n.high : n.low;
+  }
+  return set == FULL;
+}
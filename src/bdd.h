@@ -0,0 +1,60 @@
+#ifndef RCHK_BDD_H
+#define RCHK_BDD_H
+
+#include "common.h"
+#include "packedbits.h"
+
+#include <unordered_map>
+#include <vector>
+
+// a minimal reduced ordered binary decision diagram (BDD) package, for keeping large sets of
+// bit vectors (e.g. guard valuations) compactly
+//
+// a set is represented by its root node, all sets of a manager share nodes; variable i is bit i
+// of the vectors and the variables are ordered by index; nodes are never freed individually,
+// only all at once by clear()
+
+class BddTy {
+
+  public:
+    typedef unsigned NodeTy;
+    static const NodeTy EMPTY = 0; // the false terminal
+    static const NodeTy FULL = 1; // the true terminal
+
+  private:
+    struct NodeEntryTy {
+      unsigned var;
+      NodeTy low; // var is 0
+      NodeTy high; // var is 1
+
+      bool operator==(const NodeEntryTy& other) const { return var == other.var && low == other.low && high == other.high; }
+    };
+
+    struct NodeEntryTy_hash {
+      size_t operator()(const NodeEntryTy& n) const {
+        size_t res = 0;
+        hash_combine(res, n.var);
+        hash_combine(res, n.low);
+        hash_combine(res, n.high);
+        return res;
+      }
+    };
+
+    std::vector<NodeEntryTy> nodes; // indexed by node, including the terminals
+    std::unordered_map<NodeEntryTy, NodeTy, NodeEntryTy_hash> unique;
+
+    NodeTy make(unsigned var, NodeTy low, NodeTy high);
+    NodeTy insert(NodeTy set, const PackedBitsTy& bits, unsigned var);
+
+  public:
+    BddTy() { clear(); }
+
+    // the set with bits added, bits have to have the same size for all sets of the manager
+    NodeTy insert(NodeTy set, const PackedBitsTy& bits) { return insert(set, bits, 0); }
+    bool contains(NodeTy set, const PackedBitsTy& bits) const;
+
+    size_t size() const { return nodes.size(); } // number of nodes, for statistics
+    void clear();
+};
+
+#endif
@@ -8,15 +8,24 @@
 #include "table.h"
 #include "exceptions.h"
 #include "patterns.h"
+#include "deadline.h"
+#include "counters.h"
+#include "analysiscache.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <map>
 #include <stack>
 #include <unordered_set>
 
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/Support/Format.h>
 
 using namespace llvm;
 
@@ -36,6 +45,11 @@ const bool ONLY_TRACE_ONLY_FUNCTION = true;
 
 const bool KEEP_CALLED_IN_STATE = false;
 
+static CounterTy calledFunctionHitsCounter("callocators called function hits");
+static CounterTy calledFunctionMissesCounter("callocators called function misses");
+static CounterTy contextMergesCounter("callocators context merges");
+static CounterTy doneSetCollisionsCounter("callocators doneset collisions");
+
 bool CalledFunctionTy::hasContext() const {
   if (!argInfo) {
     return false;
@@ -187,29 +201,69 @@ const CalledFunctionTy* CalledModuleTy::getCalledFunction(Value *inst, SEXPGuard
     // not a symbol, leave argInfo as NULL
   }
       
-  CalledFunctionTy calledFunction(fun, intern(argInfo), this);
-  const CalledFunctionTy* cf = intern(calledFunction);
+  const CalledFunctionTy* cf = internWithContext(fun, argInfo);
   
   if (registerCallSite) {
-    auto csearch = callSiteTargets.find(inst);
-    if (csearch == callSiteTargets.end()) {
-      CalledFunctionsSetTy newSet;
-      newSet.insert(cf);
-      callSiteTargets.insert({inst, newSet});
-    } else {
-      CalledFunctionsSetTy& existingSet = csearch->second;
-      existingSet.insert(cf);
-    }
+    callSiteTargets.add(inst, cf);
   }
   
   return cf;
 }
 
+const CalledFunctionTy* CalledModuleTy::internWithContext(Function *fun, ArgInfosVectorTy& argInfo) {
+
+  unsigned nKnown = 0;
+  for(ArgInfosVectorTy::iterator ai = argInfo.begin(), ae = argInfo.end(); ai != ae; ++ai) {
+    if (!*ai) {
+      continue;
+    }
+    if (maxContextArgs && nKnown == maxContextArgs) {
+      *ai = NULL; // k-limiting, keep only the first arguments
+      continue;
+    }
+    nKnown++;
+  }
+
+  CalledFunctionTy calledFunction(fun, intern(argInfo), this);
+  const CalledFunctionTy* cf = calledFunctionsTable.find(calledFunction);
+  if (cf) {
+    calledFunctionHitsCounter.inc();
+    return cf;
+  }
+  calledFunctionMissesCounter.inc();
+  if (!nKnown) {
+    return intern(calledFunction);
+  }
+
+  ContextStatsTy& stats = contextStats[fun];
+  if (!maxContexts || stats.contexts < maxContexts) {
+    stats.contexts++;
+    return intern(calledFunction);
+  }
+
+  // too many contexts, merge into the context-free version
+  contextMergesCounter.inc();
+  stats.merged.insert(calledFunction.argInfo);
+  ArgInfosVectorTy noInfo(argInfo.size(), NULL);
+  CalledFunctionTy contextFree(fun, intern(noInfo), this);
+  return intern(contextFree);
+}
+
+static unsigned contextBound(const char *name) {
+  const char *env = getenv(name);
+  if (!env) {
+    return 0;
+  }
+  int n = atoi(env);
+  return (n > 0) ? n : 0;
+}
+
 CalledModuleTy::CalledModuleTy(Module *m, SymbolsMapTy *symbolsMap, FunctionsSetTy* errorFunctions, GlobalsTy* globals, 
   FunctionsSetTy* possibleAllocators, FunctionsSetTy* allocatingFunctions):
   
   m(m), symbolsMap(symbolsMap), errorFunctions(errorFunctions), globals(globals), possibleAllocators(possibleAllocators), allocatingFunctions(allocatingFunctions),
-  callSiteTargets(), vrfState(NULL), gcFunction(getCalledFunction(getGCFunction(m)))  {
+  callSiteTargets(), vrfState(NULL), maxContexts(contextBound("RCHK_MAX_CONTEXTS")), maxContextArgs(contextBound("RCHK_MAX_CONTEXT_ARGS")),
+  contextStats(), gcFunction(getCalledFunction(getGCFunction(m)))  {
 
   for(Module::iterator fi = m->begin(), fe = m->end(); fi != fe; ++fi) {
     Function *fun = &*fi;
@@ -440,6 +494,7 @@ bool CAllocStateTy::add() {
     workList.push(insertedState); // make the worklist point to the doneset
     return true;
   } else {
+    doneSetCollisionsCounter.inc();
     return false;
   }
 }
@@ -496,6 +551,8 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
   
   bool intGuardsEnabled = !avoidIntGuardsFor(f);
   bool sexpGuardsEnabled = !avoidSEXPGuardsFor(f);
+  DeadlineTy deadline;
+  deadline.startFunction();
   
   {
     CAllocStateTy* initState = new CAllocStateTy(&f->fun->getEntryBlock());
@@ -520,8 +577,14 @@ static void getCalledAndWrappedFunctions(const CalledFunctionTy *f, LineMessenge
       continue;
     }
       
-    if (doneSet.size() > MAX_STATES) {
-      errs() << "ERROR: too many states (abstraction error?) in function " << funName(f) << "\n";
+    bool timedOut = deadline.expired();
+    if (doneSet.size() > MAX_STATES || timedOut) {
+      if (timedOut) {
+        errs() << "ERROR: time budget exhausted in function " << funName(f) << "\n";
+        recordTimeout(f->fun, "called allocators - " + funName(f), deadline.elapsed());
+      } else {
+        errs() << "ERROR: too many states (abstraction error?) in function " << funName(f) << "\n";
+      }
       clearStates();
       delete intGuardsChecker;
       delete sexpGuardsChecker;
@@ -833,11 +896,15 @@ void CalledModuleTy::computeCalledAllocators() {
   if (possibleCAllocators && allocatingCFunctions) {
     return;
   }
+  if (loadCalledAllocators()) {
+    return;
+  }
   
   possibleCAllocators = new CalledFunctionsSetTy();
   allocatingCFunctions = new CalledFunctionsSetTy();
   
   LineMessenger msg(m->getContext(), DEBUG, TRACE, UNIQUE_MSG);
+  unsigned timeoutsBefore = numberOfTimeouts();
   
   unsigned nfuncs = getNumberOfCalledFunctions(); // NOTE: nfuncs can increase during the checking
 
@@ -855,7 +922,11 @@ void CalledModuleTy::computeCalledAllocators() {
     
     CalledFunctionsOrderedSetTy called;
     CalledFunctionsOrderedSetTy wrapped;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     getCalledAndWrappedFunctions(f, msg, called, wrapped);
+    ContextStatsTy& stats = contextStats[f->fun];
+    stats.explored++;
+    stats.exploreTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     
     if (DEBUG && called.size()) {
       errs() << "\nDetected (possible allocators) called by function " << funName(f) << ":\n";
@@ -938,6 +1009,330 @@ void CalledModuleTy::computeCalledAllocators() {
   possibleCAllocators->insert(gcFunction);
   contextSensitiveAllocatingFunctions->insert(gcFunction->fun);
   contextSensitivePossibleAllocators->insert(gcFunction->fun);
+
+  callSiteTargets.compact(*allocatingCFunctions);
+  if (numberOfTimeouts() == timeoutsBefore) { // the conservative results of functions out of time depend on timing
+    saveCalledAllocators();
+  }
+  printContextStats();
+}
+
+// the cached result has a line per called function, in the order of their indexes, with flags
+// (a)llocating and (p)ossible allocator, the function name and an info per argument (? for no
+// info, V for a vector, S:name for a symbol), and then a line per registered call site, with the
+// name of the function containing it, the position of the call in that function and the lines
+// (0-based) of the target called functions
+//
+//   ap fun arginfo...
+//   c fun position target...
+//
+// all called functions are kept, so that the contexts created while computing the allocators are
+// counted towards the bounds in the same way; the bounds are part of the analysis name
+
+static std::string calledAllocatorsAnalysis(unsigned maxContexts, unsigned maxContextArgs) {
+  return "calledallocators-" + std::to_string(maxContexts) + "-" + std::to_string(maxContextArgs);
+}
+
+static void numberInstructions(Function *f, std::vector<Instruction*>& instructions) {
+  for(inst_iterator ii = inst_begin(*f), ie = inst_end(*f); ii != ie; ++ii) {
+    instructions.push_back(&*ii);
+  }
+}
+
+void CalledModuleTy::saveCalledAllocators() {
+
+  std::vector<std::string> lines;
+  const CalledFunctionsIndexTy* index = getCalledFunctions();
+  for(unsigned i = 0, n = index->size(); i < n; i++) {
+    const CalledFunctionTy *cf = index->at(i);
+    if (!cf->argInfo || m->getFunction(cf->fun->getName()) != cf->fun) {
+      return; // cannot be restored
+    }
+    std::string line;
+    line += (allocatingCFunctions->find(cf) != allocatingCFunctions->end()) ? 'a' : '-';
+    line += (possibleCAllocators->find(cf) != possibleCAllocators->end()) ? 'p' : '-';
+    line += "\t" + cf->fun->getName().str();
+
+    for(ArgInfosVectorTy::const_iterator ai = cf->argInfo->begin(), ae = cf->argInfo->end(); ai != ae; ++ai) {
+      const ArgInfoTy *a = *ai;
+      if (a && a->isSymbol()) {
+        const std::string& symbolName = static_cast<const SymbolArgInfoTy*>(a)->symbolName;
+        if (symbolName.find_first_of("\t\n") != std::string::npos) {
+          return;
+        }
+        line += "\tS:" + symbolName;
+      } else if (a && a->isVector()) {
+        line += "\tV";
+      } else {
+        line += "\t?";
+      }
+    }
+    lines.push_back(line);
+  }
+
+  std::unordered_map<const Instruction*, unsigned> positions;
+  FunctionsSetTy numbered;
+  for(unsigned id = 0, nsites = callSiteTargets.size(); id < nsites; id++) {
+    Instruction *in = dyn_cast<Instruction>(callSiteTargets.getCallSite(id));
+    if (!in) {
+      return;
+    }
+    Function *f = in->getParent()->getParent();
+    if (numbered.insert(f).second) {
+      std::vector<Instruction*> instructions;
+      numberInstructions(f, instructions);
+      for(unsigned pos = 0, ninsts = instructions.size(); pos < ninsts; pos++) {
+        positions.insert({instructions[pos], pos});
+      }
+    }
+    std::string line = "c\t" + f->getName().str() + "\t" + std::to_string(positions[in]);
+    for(const CalledFunctionTy* const* ti = callSiteTargets.targetsBegin(id), * const* te = callSiteTargets.targetsEnd(id); ti != te; ++ti) {
+      line += "\t" + std::to_string((*ti)->idx);
+    }
+    lines.push_back(line);
+  }
+
+  saveCachedLines(m, calledAllocatorsAnalysis(maxContexts, maxContextArgs), lines);
+}
+
+struct CachedCalledFunctionTy {
+  Function *fun;
+  ArgInfosVectorTy argInfo;
+  bool allocating;
+  bool possibleAllocator;
+};
+
+struct CachedCallSiteTy {
+  Instruction *inst;
+  std::vector<unsigned> targets; // lines of the called functions
+};
+
+bool CalledModuleTy::loadCalledAllocators() {
+
+  std::string analysis = calledAllocatorsAnalysis(maxContexts, maxContextArgs);
+  std::vector<std::string> lines;
+  if (!loadCachedLines(m, analysis, lines)) {
+    return false;
+  }
+
+  // parse all lines first, so that an invalid cache does not leave anything behind
+  std::vector<CachedCalledFunctionTy> functions;
+  std::vector<CachedCallSiteTy> sites;
+  std::unordered_map<Function*, std::vector<Instruction*>> instructions;
+
+  for(std::vector<std::string>::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    SmallVector<StringRef, 8> fields;
+    StringRef(*li).split(fields, '\t');
+
+    bool valid = fields.size() >= 2;
+    Function *fun = valid ? m->getFunction(fields[1]) : NULL;
+    valid = valid && fun;
+
+    if (valid && fields[0] == "c") {
+      CachedCallSiteTy site;
+      unsigned pos;
+      std::vector<Instruction*>& insts = instructions[fun];
+      if (insts.empty()) {
+        numberInstructions(fun, insts);
+      }
+      valid = fields.size() >= 3 && !fields[2].getAsInteger(10, pos) && pos < insts.size();
+      for(unsigned i = 3; valid && i < fields.size(); i++) {
+        unsigned target;
+        valid = !fields[i].getAsInteger(10, target) && target < functions.size();
+        site.targets.push_back(target);
+      }
+      if (valid) {
+        site.inst = insts[pos];
+        sites.push_back(site);
+      }
+
+    } else if (valid && fields[0].size() == 2 && sites.empty()) {
+      CachedCalledFunctionTy cf;
+      cf.fun = fun;
+      cf.allocating = fields[0][0] == 'a';
+      cf.possibleAllocator = fields[0][1] == 'p';
+      for(unsigned i = 2; valid && i < fields.size(); i++) {
+        if (fields[i] == "?") {
+          cf.argInfo.push_back(NULL);
+        } else if (fields[i] == "V") {
+          cf.argInfo.push_back(VectorArgInfoTy::get());
+        } else if (fields[i].startswith("S:")) {
+          cf.argInfo.push_back(SymbolArgInfoTy::create(fields[i].drop_front(2).str()));
+        } else {
+          valid = false;
+        }
+      }
+      if (valid) {
+        functions.push_back(cf);
+      }
+    } else {
+      valid = false;
+    }
+
+    if (!valid) {
+      errs() << "Ignoring invalid analysis cache " << analysis << ": " << *li << "\n";
+      return false;
+    }
+  }
+
+  // intern the called functions in the same order as when they were computed
+  std::vector<const CalledFunctionTy*> loaded;
+  for(std::vector<CachedCalledFunctionTy>::iterator fi = functions.begin(), fe = functions.end(); fi != fe; ++fi) {
+    loaded.push_back(internWithContext(fi->fun, fi->argInfo));
+  }
+
+  possibleCAllocators = new CalledFunctionsSetTy();
+  allocatingCFunctions = new CalledFunctionsSetTy();
+  contextSensitiveAllocatingFunctions = new FunctionsSetTy();
+  contextSensitivePossibleAllocators = new FunctionsSetTy();
+
+  for(unsigned i = 0, n = functions.size(); i < n; i++) {
+    const CalledFunctionTy *tgt = loaded[i];
+    if (functions[i].allocating) {
+      allocatingCFunctions->insert(tgt);
+      if (!tgt->hasContext()) {
+        contextSensitiveAllocatingFunctions->insert(tgt->fun);
+      }
+    }
+    if (functions[i].possibleAllocator) {
+      possibleCAllocators->insert(tgt);
+      if (!tgt->hasContext()) {
+        contextSensitivePossibleAllocators->insert(tgt->fun);
+      }
+    }
+  }
+  allocatingCFunctions->insert(gcFunction);
+  possibleCAllocators->insert(gcFunction);
+  contextSensitiveAllocatingFunctions->insert(gcFunction->fun);
+  contextSensitivePossibleAllocators->insert(gcFunction->fun);
+
+  for(std::vector<CachedCallSiteTy>::const_iterator si = sites.begin(), se = sites.end(); si != se; ++si) {
+    for(std::vector<unsigned>::const_iterator ti = si->targets.begin(), te = si->targets.end(); ti != te; ++ti) {
+      callSiteTargets.add(si->inst, loaded[*ti]);
+    }
+  }
+  callSiteTargets.compact(*allocatingCFunctions);
+  return true;
+}
+
+const CallSiteTargetsTy* CalledModuleTy::getCallSiteTargets() {
+  computeCalledAllocators();
+  callSiteTargets.compact(*allocatingCFunctions); // call sites may have been registered since
+  return &callSiteTargets;
+}
+
+void CallSiteTargetsTy::add(Value *inst, const CalledFunctionTy *target) {
+
+  auto iinsert = ids.insert({inst, sites.size()});
+  unsigned id = iinsert.first->second;
+  if (iinsert.second) {
+    sites.push_back(inst);
+  }
+
+  if (compacted) {
+    if (!iinsert.second && std::find(targetsBegin(id), targetsEnd(id), target) != targetsEnd(id)) {
+      return;
+    }
+    // a new target after compaction (e.g. when debugging in bcheck), expand again
+    unsigned ncompacted = offsets.size() - 1;
+    pending.resize(ncompacted);
+    for(unsigned i = 0; i < ncompacted; i++) {
+      pending[i].assign(targetsBegin(i), targetsEnd(i));
+    }
+    offsets.assign(1, 0);
+    targets.clear();
+    gcBits.clear();
+    compacted = false;
+  }
+
+  pending.resize(sites.size());
+  std::vector<const CalledFunctionTy*>& siteTargets = pending[id];
+  if (std::find(siteTargets.begin(), siteTargets.end(), target) == siteTargets.end()) {
+    siteTargets.push_back(target); // there are very few targets per call site
+  }
+}
+
+void CallSiteTargetsTy::compact(const CalledFunctionsSetTy& allocatingCFunctions) {
+
+  if (compacted) {
+    return;
+  }
+  unsigned nsites = sites.size();
+  offsets.clear();
+  offsets.reserve(nsites + 1);
+  offsets.push_back(0);
+  targets.clear();
+  gcBits.assign(nsites, false);
+
+  for(unsigned id = 0; id < nsites; id++) {
+    const std::vector<const CalledFunctionTy*>& siteTargets = pending[id];
+    for(std::vector<const CalledFunctionTy*>::const_iterator ti = siteTargets.begin(), te = siteTargets.end(); ti != te; ++ti) {
+      const CalledFunctionTy *target = *ti;
+      targets.push_back(target);
+      if (allocatingCFunctions.find(target) != allocatingCFunctions.end()) {
+        gcBits[id] = true;
+      }
+    }
+    offsets.push_back(targets.size());
+  }
+  std::vector<std::vector<const CalledFunctionTy*>>().swap(pending); // free memory
+  compacted = true;
+}
+
+unsigned CallSiteTargetsTy::getId(Value *inst) const {
+  auto isearch = ids.find(inst);
+  if (isearch == ids.end()) {
+    return NO_CALL_SITE;
+  }
+  return isearch->second;
+}
+
+void CalledModuleTy::printContextStats() {
+
+  if (!getenv("RCHK_CONTEXT_STATS")) {
+    return;
+  }
+
+  std::vector<std::pair<Function*, const ContextStatsTy*>> funs;
+  unsigned totalContexts = 0;
+  unsigned totalMerged = 0;
+  double totalTime = 0;
+  double totalSaved = 0;
+
+  for(ContextStatsMapTy::const_iterator si = contextStats.begin(), se = contextStats.end(); si != se; ++si) {
+    const ContextStatsTy& stats = si->second;
+    totalContexts += stats.contexts;
+    totalMerged += stats.merged.size();
+    totalTime += stats.exploreTime;
+    if (stats.explored) {
+      totalSaved += stats.merged.size() * (stats.exploreTime / stats.explored);
+    }
+    if (stats.contexts) {
+      funs.push_back({si->first, &stats});
+    }
+  }
+  std::sort(funs.begin(), funs.end(), [](const std::pair<Function*, const ContextStatsTy*>& a, const std::pair<Function*, const ContextStatsTy*>& b) {
+    if (a.second->contexts != b.second->contexts) {
+      return a.second->contexts > b.second->contexts;
+    }
+    return a.first->getName() < b.first->getName();
+  });
+
+  errs() << "Contexts: " << totalContexts << " in " << funs.size() << " functions, " << totalMerged << " merged (bound "
+    << maxContexts << " per function, " << maxContextArgs << " arguments), exploration took " << format("%.2f", totalTime)
+    << "s, estimated " << format("%.2f", totalSaved) << "s saved\n";
+
+  for(std::vector<std::pair<Function*, const ContextStatsTy*>>::const_iterator fi = funs.begin(), fe = funs.end(); fi != fe; ++fi) {
+    const ContextStatsTy& stats = *fi->second;
+    double perExplored = stats.explored ? stats.exploreTime / stats.explored : 0;
+
+    errs() << "  " << funName(fi->first) << ": " << stats.contexts << " contexts, " << stats.merged.size() << " merged, "
+      << stats.explored << " explored in " << format("%.3f", stats.exploreTime) << "s";
+    if (!stats.merged.empty()) {
+      errs() << ", estimated " << format("%.3f", stats.merged.size() * perExplored) << "s saved";
+    }
+    errs() << "\n";
+  }
 }
 
 std::string funName(const CalledFunctionTy *cf) {
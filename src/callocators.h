@@ -10,7 +10,9 @@ class CalledModuleTy;
 #include "symbols.h"
 #include "table.h"
 #include "vectors.h"
+#include "zobrist.h"
 
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -117,10 +119,61 @@ typedef InterningTable<ArgInfosVectorTy, ArgInfosVectorTy_hash> ArgInfoVectorsTa
 
   // yikes, need forward type def
 struct SEXPGuardTy;
+struct SEXPGuardsEntry_hash;
 class SEXPGuardsChecker;
-typedef std::map<AllocaInst*,SEXPGuardTy> SEXPGuardsTy;
+typedef ZobristMapTy<AllocaInst*,SEXPGuardTy,SEXPGuardsEntry_hash> SEXPGuardsTy;
+
+// targets of call sites registered while computing called allocators
+//
+// call sites get dense ids in the order they are registered; the targets are collected per call site
+// and, once the allocating called functions are known, compacted into a compressed sparse row
+// layout (targets of call site i are targets[offsets[i]] to targets[offsets[i+1]-1]) with a bit
+// per call site telling whether any of its targets may call into the GC
+
+class CallSiteTargetsTy {
+  std::unordered_map<Value*, unsigned> ids;
+  std::vector<Value*> sites; // by id
+  std::vector<std::vector<const CalledFunctionTy*>> pending; // by id, targets not yet compacted
+  std::vector<unsigned> offsets;
+  std::vector<const CalledFunctionTy*> targets;
+  std::vector<bool> gcBits; // by id
+  bool compacted;
 
-typedef std::map<Value*, CalledFunctionsSetTy> CallSiteTargetsTy;
+  public:
+    static const unsigned NO_CALL_SITE = (unsigned) -1;
+
+    CallSiteTargetsTy(): ids(), sites(), pending(), offsets(1, 0), targets(), gcBits(), compacted(true) {}
+
+    void add(Value *inst, const CalledFunctionTy *target);
+    void compact(const CalledFunctionsSetTy& allocatingCFunctions);
+    bool isCompacted() const { return compacted; }
+
+    unsigned size() const { return sites.size(); }
+    unsigned getId(Value *inst) const; // NO_CALL_SITE if not registered
+    Value* getCallSite(unsigned id) const { return sites[id]; }
+
+      // only valid when compacted
+    const CalledFunctionTy* const* targetsBegin(unsigned id) const { return targets.data() + offsets[id]; }
+    const CalledFunctionTy* const* targetsEnd(unsigned id) const { return targets.data() + offsets[id + 1]; }
+    bool mayCallGC(unsigned id) const { return gcBits[id]; }
+};
+
+// context sensitivity can be bounded via environment variables
+//   RCHK_MAX_CONTEXTS      maximum number of contexts (called functions with some argument info) per function,
+//                          calls in further contexts are merged into the context-free version
+//   RCHK_MAX_CONTEXT_ARGS  maximum number of arguments with info in a context, only the first ones are kept
+// (unset or 0 means no bound); statistics are printed when RCHK_CONTEXT_STATS is set
+
+struct ContextStatsTy {
+  unsigned contexts; // contexts created
+  std::unordered_set<const ArgInfosVectorTy*> merged; // contexts merged into the context-free version (interned)
+  unsigned explored; // called functions explored when computing called allocators
+  double exploreTime; // in seconds
+
+  ContextStatsTy(): contexts(0), merged(), explored(0), exploreTime(0) {}
+};
+
+typedef std::unordered_map<Function*, ContextStatsTy> ContextStatsMapTy;
 
 class CalledModuleTy {
   CalledFunctionsTableTy calledFunctionsTable; // intern table
@@ -136,15 +189,22 @@ class CalledModuleTy {
   FunctionsSetTy* contextSensitiveAllocatingFunctions;
   CalledFunctionsSetTy* possibleCAllocators;
   CalledFunctionsSetTy* allocatingCFunctions;
-  CallSiteTargetsTy callSiteTargets; // maps  call instruction -> set of target functions
+  CallSiteTargetsTy callSiteTargets; // maps call instruction -> target functions
   VrfStateTy* vrfState; // state for vector returning functions detection
+  unsigned maxContexts;
+  unsigned maxContextArgs;
+  ContextStatsMapTy contextStats;
   
   const CalledFunctionTy* const gcFunction;
 
   private:
     const ArgInfosVectorTy* intern(const ArgInfosVectorTy& argInfos) { return argInfoVectorsTable.intern(argInfos); }
     const CalledFunctionTy* intern(const CalledFunctionTy& calledFunction) { return calledFunctionsTable.intern(calledFunction); }
+    const CalledFunctionTy* internWithContext(Function *fun, ArgInfosVectorTy& argInfo); // applies the bounds
     void computeCalledAllocators();
+    bool loadCalledAllocators(); // from the analysis cache (analysiscache.h)
+    void saveCalledAllocators();
+    void printContextStats();
 
   public:
     CalledModuleTy(Module *m, SymbolsMapTy* symbolsMap, FunctionsSetTy* errorFunctions, GlobalsTy* globals,
@@ -161,7 +221,7 @@ class CalledModuleTy {
     size_t getNumberOfCalledFunctions() { return calledFunctionsTable.getIndex()->size(); }
     const CalledFunctionsSetTy* getPossibleCAllocators() { computeCalledAllocators(); return possibleCAllocators; }
     const CalledFunctionsSetTy* getAllocatingCFunctions() { computeCalledAllocators(); return allocatingCFunctions; }
-    const CallSiteTargetsTy* getCallSiteTargets() { computeCalledAllocators(); return &callSiteTargets; }
+    const CallSiteTargetsTy* getCallSiteTargets();
     
     virtual ~CalledModuleTy();
     
@@ -179,8 +239,7 @@ class CalledModuleTy {
     Module* getModule() { return m; }
     const CalledFunctionTy* getCalledGCFunction() { return gcFunction; }
     SymbolsMapTy* getSymbolsMap() { return symbolsMap; }
-    void computeVectorReturningFunctions() { if (vrfState == NULL) findVectorReturningFunctions(this); }
-    VrfStateTy* getVrfState() { computeVectorReturningFunctions(); return vrfState; }
+    VrfStateTy* getVrfState() { if (vrfState == NULL) vrfState = createVrfState(); return vrfState; } // functions are analyzed on demand
     void setVrfState(VrfStateTy* vrfState) { this->vrfState = vrfState; }
 };
 
@@ -1,6 +1,7 @@
 
 #include "cgclosure.h"
 #include "errors.h"
+#include "exceptions.h"
 
 #include <llvm/Analysis/CallGraph.h>
 
@@ -10,10 +11,71 @@ using namespace llvm;
 
 const bool DEBUG = false;
 
+typedef std::vector<std::vector<FunctionInfo*>> CallersTy; // indexed by function index
+
+// marks functions that call (directly or not) any of the functions in the worklist
+
+static void markCallers(const CallersTy& callers, std::vector<FunctionInfo*>& workList, std::vector<bool>& marked) {
+
+  while(!workList.empty()) {
+    FunctionInfo *finfo = workList.back();
+    workList.pop_back();
+
+    const std::vector<FunctionInfo*>& fcallers = callers[finfo->index];
+    for(std::vector<FunctionInfo*>::const_iterator ci = fcallers.begin(), ce = fcallers.end(); ci != ce; ++ci) {
+      FunctionInfo *caller = *ci;
+      if (!marked[caller->index]) {
+        marked[caller->index] = true;
+        workList.push_back(caller);
+      }
+    }
+  }
+}
+
+// computes reachesGC from the direct calls, by searching the reversed callgraph
+//   (linear, unlike checking the closure of each called function at each call site)
+
+static void markFunctionsReachingGC(FunctionsInfoMapTy& functionsMap, Function *gcFunction) {
+
+  auto gsearch = functionsMap.find(gcFunction);
+  if (gsearch == functionsMap.end()) {
+    return;
+  }
+
+  unsigned n = functionsMap.size();
+  CallersTy callers(n);
+  for(FunctionsInfoMapTy::iterator FI = functionsMap.begin(), FE = functionsMap.end(); FI != FE; ++FI) {
+    FunctionInfo& finfo = FI->second;
+    for(std::vector<FunctionInfo*>::iterator TFI = finfo.calledFunctionsList.begin(), TFE = finfo.calledFunctionsList.end(); TFI != TFE; ++TFI) {
+      callers[(*TFI)->index].push_back(&finfo);
+    }
+  }
+
+  std::vector<FunctionInfo*> workList;
+  std::vector<bool> callsGC(n, false);
+  workList.push_back(&gsearch->second);
+  markCallers(callers, workList, callsGC);
+
+  std::vector<bool> reaches(n, false);
+  for(FunctionsInfoMapTy::iterator FI = functionsMap.begin(), FE = functionsMap.end(); FI != FE; ++FI) {
+    FunctionInfo& finfo = FI->second;
+    if (callsGC[finfo.index] && !isAssertedNonAllocating(const_cast<Function*>(finfo.function))) {
+      workList.push_back(&finfo);
+    }
+  }
+  markCallers(callers, workList, reaches);
+
+  for(FunctionsInfoMapTy::iterator FI = functionsMap.begin(), FE = functionsMap.end(); FI != FE; ++FI) {
+    FunctionInfo& finfo = FI->second;
+    finfo.reachesGC = reaches[finfo.index];
+  }
+}
+
 // build closure over the callgraph of module m
 // each function from module m gets its FunctionInfo in the functionsMap
 
-void buildCGClosure(Module *m, FunctionsInfoMapTy& functionsMap, bool ignoreErrorPaths, FunctionsSetTy *onlyFunctions, CallEdgesMapTy *onlyEdges, Function* externalFunction) {
+void buildCGClosure(Module *m, FunctionsInfoMapTy& functionsMap, bool ignoreErrorPaths, FunctionsSetTy *onlyFunctions, CallEdgesMapTy *onlyEdges, Function* externalFunction,
+  Function* gcFunction, bool closure) {
 
   FunctionsSetTy errorFunctions;
   if (ignoreErrorPaths) {
@@ -159,6 +221,14 @@ void buildCGClosure(Module *m, FunctionsInfoMapTy& functionsMap, bool ignoreErro
       (finfo.callsFunctionMap)[targetFinfo->index] = true; 
     }
   }
+
+  if (gcFunction) {
+    markFunctionsReachingGC(functionsMap, gcFunction);
+  }
+  if (!closure) {
+    delete cg;
+    return;
+  }
   
   // compute transitive closure
   // no attempts were made to make this efficient
@@ -28,9 +28,10 @@ struct FunctionInfo {
   std::vector<bool> callsFunctionMap;
   std::vector<FunctionInfo*> calledFunctionsList;
   const unsigned index;
+  bool reachesGC; // may call a function that calls into the GC and is not asserted non-allocating (only when gcFunction given)
   
   public:
-  FunctionInfo(const Function* const f, unsigned long index, unsigned long maxFunctions): function(f), callInfos(), callsFunctionMap(maxFunctions, false), index(index) {};
+  FunctionInfo(const Function* const f, unsigned long index, unsigned long maxFunctions): function(f), callInfos(), callsFunctionMap(maxFunctions, false), index(index), reachesGC(false) {};
 };
 
 typedef std::map<Function*, FunctionInfo> FunctionsInfoMapTy;
@@ -38,7 +39,9 @@ typedef std::map<Function*, FunctionInfo> FunctionsInfoMapTy;
 typedef std::unordered_set<Function*> FunctionsSetTy;
 typedef std::map<Function*, FunctionsSetTy*> CallEdgesMapTy;
 
+// with closure=false, callsFunctionMap and calledFunctionsList only include direct calls
+//   (enough when only reachesGC is needed)
 void buildCGClosure(Module *m, FunctionsInfoMapTy& functionsMap, bool ignoreErrorPaths = true, FunctionsSetTy *onlyFunctions = NULL, CallEdgesMapTy *onlyEdges = NULL, 
-  Function* externalFunction = NULL);
+  Function* externalFunction = NULL, Function* gcFunction = NULL, bool closure = true);
 
 #endif
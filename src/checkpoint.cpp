@@ -0,0 +1,273 @@
+
+#include "checkpoint.h"
+#include "profile.h"
+#include "shard.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+// the checkpoint file has one record per line, with tab-separated fields (tabs, newlines and
+// backslashes in the fields are escaped)
+//
+//   inputs hash                         (of the input files and the rchk build)
+//   function name states
+//   error text                          (of the function above)
+//   checks name                         (of the function above)
+//   message kind message path line      (of the checks above)
+
+const unsigned DEFAULT_CHECKPOINT_INTERVAL = 60;
+
+static std::string escapeField(const std::string& s) {
+  std::string res;
+  for(std::string::const_iterator ci = s.begin(), ce = s.end(); ci != ce; ++ci) {
+    switch(*ci) {
+      case '\\': res += "\\\\"; break;
+      case '\t': res += "\\t"; break;
+      case '\n': res += "\\n"; break;
+      default: res += *ci;
+    }
+  }
+  return res;
+}
+
+static std::string unescapeField(StringRef s) {
+  std::string res;
+  for(size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '\\' && i + 1 < s.size()) {
+      char c = s[++i];
+      res += (c == 't') ? '\t' : (c == 'n') ? '\n' : c;
+    } else {
+      res += s[i];
+    }
+  }
+  return res;
+}
+
+static std::string checkpointFileName(const std::string& dir, Module *m, const std::string& tool) {
+  std::string shard = shardFileId(); // shards of a module check different functions
+  return dir + "/" + tool + "-" + moduleFileId(m) + (shard.empty() ? "" : "-" + shard) + ".checkpoint";
+}
+
+CheckpointTy::CheckpointTy(Module *m, const std::string& tool): fileName(), inputsHash(0), functions(), order(), current(),
+  interval(DEFAULT_CHECKPOINT_INTERVAL), lastSave(std::chrono::steady_clock::now()) {
+
+  const char *env = getenv("RCHK_CHECKPOINT");
+  if (!env || !*env) {
+    return;
+  }
+  fileName = checkpointFileName(env, m, tool);
+  inputsHash = moduleInputsHash(m);
+
+  const char *ienv = getenv("RCHK_CHECKPOINT_INTERVAL");
+  if (ienv) {
+    int i = atoi(ienv);
+    if (i >= 0) {
+      interval = i;
+    }
+  }
+  if (getenv("RCHK_RESUME")) {
+    load();
+  }
+}
+
+bool CheckpointTy::load() {
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(fileName);
+  if (!res) {
+    return false; // nothing to resume
+  }
+
+  FunctionsTy loaded;
+  std::vector<std::string> loadedOrder;
+  CheckpointFunctionTy* cf = NULL;
+  bool inputsMatch = false;
+
+  StringRef rest = res.get()->getBuffer();
+  while(!rest.empty()) {
+    std::pair<StringRef, StringRef> split = rest.split('\n');
+    StringRef line = split.first;
+    rest = split.second;
+
+    if (line.empty() || line.startswith("#")) {
+      continue;
+    }
+    SmallVector<StringRef, 5> fields;
+    line.split(fields, '\t');
+
+    bool valid = false;
+    if (fields[0] == "inputs" && fields.size() == 2) {
+      uint64_t hash;
+      valid = !fields[1].getAsInteger(16, hash);
+      inputsMatch = valid && hash == inputsHash;
+
+    } else if (fields[0] == "function" && fields.size() == 3) {
+      std::string name = unescapeField(fields[1]);
+      unsigned long states;
+      valid = !fields[2].getAsInteger(10, states) && loaded.find(name) == loaded.end();
+      if (valid) {
+        cf = &loaded[name];
+        cf->states = states;
+        loadedOrder.push_back(name);
+      }
+
+    } else if ((fields[0] == "error" || fields[0] == "checks") && fields.size() == 2 && cf) {
+      CheckpointEntryTy e;
+      e.isError = fields[0] == "error";
+      e.text = unescapeField(fields[1]);
+      cf->entries.push_back(e);
+      valid = true;
+
+    } else if (fields[0] == "message" && fields.size() == 5 && cf && !cf->entries.empty() && !cf->entries.back().isError) {
+      CheckpointMessageTy msg;
+      msg.kind = unescapeField(fields[1]);
+      msg.message = unescapeField(fields[2]);
+      msg.path = unescapeField(fields[3]);
+      valid = !fields[4].getAsInteger(10, msg.line);
+      cf->entries.back().messages.push_back(msg);
+    }
+
+    if (!valid) {
+      errs() << "Ignoring invalid checkpoint " << fileName << ": " << line << "\n";
+      return false;
+    }
+  }
+
+  if (!inputsMatch) {
+    errs() << "Ignoring checkpoint " << fileName << ", the input files or the tool have changed\n";
+    return false;
+  }
+  functions.swap(loaded);
+  order.swap(loadedOrder);
+  return true;
+}
+
+const CheckpointFunctionTy* CheckpointTy::lookup(Function *f) const {
+
+  if (!enabled()) {
+    return NULL;
+  }
+  auto fsearch = functions.find(f->getName().str());
+  if (fsearch == functions.end()) {
+    return NULL;
+  }
+  return &fsearch->second;
+}
+
+void CheckpointTy::replay(Function *f, const CheckpointFunctionTy& cf, LineMessenger& msg) const {
+
+  for(std::vector<CheckpointEntryTy>::const_iterator ei = cf.entries.begin(), ee = cf.entries.end(); ei != ee; ++ei) {
+    const CheckpointEntryTy& e = *ei;
+    if (e.isError) {
+      errs() << e.text << "\n";
+      continue;
+    }
+    msg.newFunction(f, e.text);
+    for(std::vector<CheckpointMessageTy>::const_iterator mi = e.messages.begin(), me = e.messages.end(); mi != me; ++mi) {
+      LineInfoTy li(mi->kind, mi->message, mi->path, mi->line);
+      msg.emit(&li);
+    }
+  }
+  msg.flush();
+}
+
+void CheckpointTy::startFunction() {
+  current = CheckpointFunctionTy();
+}
+
+void CheckpointTy::recordError(const std::string& text) {
+
+  if (!enabled()) {
+    return;
+  }
+  CheckpointEntryTy e;
+  e.isError = true;
+  e.text = text;
+  current.entries.push_back(e);
+}
+
+void CheckpointTy::recordMessages(const std::string& checksName, const std::vector<const LineInfoTy*>& lines) {
+
+  if (!enabled()) {
+    return;
+  }
+  CheckpointEntryTy e;
+  e.isError = false;
+  e.text = checksName;
+  for(std::vector<const LineInfoTy*>::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    const LineInfoTy* l = *li;
+    CheckpointMessageTy msg;
+    msg.kind = msgString(l->kind);
+    msg.message = l->message;
+    msg.path = msgString(l->path);
+    msg.line = l->line;
+    e.messages.push_back(msg);
+  }
+  current.entries.push_back(e);
+}
+
+void CheckpointTy::endFunction(Function *f, unsigned long states) {
+
+  if (!enabled()) {
+    return;
+  }
+  std::string name = f->getName().str();
+  current.states = states;
+  if (functions.find(name) == functions.end()) {
+    order.push_back(name);
+  }
+  functions[name].entries.swap(current.entries);
+  functions[name].states = current.states;
+
+  if (std::chrono::steady_clock::now() - lastSave >= std::chrono::seconds(interval)) {
+    save();
+  }
+}
+
+void CheckpointTy::save() {
+
+  if (!enabled()) {
+    return;
+  }
+  lastSave = std::chrono::steady_clock::now();
+
+  // write a new file and rename it, so that a run killed meanwhile leaves the previous checkpoint
+  std::string tmpName = fileName + "." + std::to_string(getpid());
+  int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    errs() << "Cannot write checkpoint " << tmpName << "\n";
+    return;
+  }
+  {
+    raw_fd_ostream out(fd, true);
+    out << "# rchk checkpoint\n";
+    out << "inputs\t" << format_hex_no_prefix(inputsHash, 16) << "\n";
+    for(std::vector<std::string>::const_iterator ni = order.begin(), ne = order.end(); ni != ne; ++ni) {
+      const CheckpointFunctionTy& cf = functions[*ni];
+      out << "function\t" << escapeField(*ni) << "\t" << cf.states << "\n";
+      for(std::vector<CheckpointEntryTy>::const_iterator ei = cf.entries.begin(), ee = cf.entries.end(); ei != ee; ++ei) {
+        const CheckpointEntryTy& e = *ei;
+        out << (e.isError ? "error\t" : "checks\t") << escapeField(e.text) << "\n";
+        for(std::vector<CheckpointMessageTy>::const_iterator mi = e.messages.begin(), me = e.messages.end(); mi != me; ++mi) {
+          out << "message\t" << escapeField(mi->kind) << "\t" << escapeField(mi->message) << "\t" << escapeField(mi->path) << "\t" << mi->line << "\n";
+        }
+      }
+    }
+    out.flush();
+    fsync(fd);
+  }
+  if (rename(tmpName.c_str(), fileName.c_str())) {
+    errs() << "Cannot write checkpoint " << fileName << "\n";
+    unlink(tmpName.c_str());
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef RCHK_CHECKPOINT_H
+#define RCHK_CHECKPOINT_H
+
+#include "common.h"
+#include "linemsg.h"
+
+#include <chrono>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+
+using namespace llvm;
+
+// checkpoints of checking a module, so that a killed run can be resumed
+//
+// when environment variable RCHK_CHECKPOINT is set to a directory, the functions checked so far are
+// saved there periodically (every RCHK_CHECKPOINT_INTERVAL seconds, 60 by default) and at the end,
+// each with the messages and errors it produced; when also RCHK_RESUME is set, a checkpoint of the
+// same module found there is loaded and the functions in it are not checked again, their messages
+// are printed from the checkpoint instead (so the output is the same as from an uninterrupted run)
+//
+// a checkpoint is only used when the input files and the rchk build have not changed (the hash of
+// their contents is the same), so that also the source locations in the messages are up to date; the
+// results of the module analyses (allocators, callee-protect functions) are saved into the same
+// directory by the analysis cache (analysiscache.h), so they are not computed again when resuming
+
+struct CheckpointMessageTy {
+  std::string kind;
+  std::string message;
+  std::string path;
+  unsigned line;
+};
+
+struct CheckpointEntryTy { // in the order produced
+  bool isError; // error printed to stderr, or messages of one checks name
+  std::string text; // error text or checks name
+  std::vector<CheckpointMessageTy> messages;
+};
+
+struct CheckpointFunctionTy {
+  unsigned long states;
+  std::vector<CheckpointEntryTy> entries;
+
+  CheckpointFunctionTy(): states(0), entries() {}
+};
+
+class CheckpointTy {
+
+  typedef std::map<std::string, CheckpointFunctionTy> FunctionsTy; // keyed by function name
+
+  std::string fileName;
+  uint64_t inputsHash;
+  FunctionsTy functions; // completed functions
+  std::vector<std::string> order; // of completion
+  CheckpointFunctionTy current;
+  unsigned interval; // in seconds
+  std::chrono::steady_clock::time_point lastSave;
+
+  bool load();
+
+  public:
+    CheckpointTy(Module *m, const std::string& tool);
+
+    bool enabled() const { return !fileName.empty(); }
+    const CheckpointFunctionTy* lookup(Function *f) const; // NULL if not completed in a previous run
+    void replay(Function *f, const CheckpointFunctionTy& cf, LineMessenger& msg) const; // prints the messages and errors again
+
+      // recording of the function being checked
+    void startFunction();
+    void recordError(const std::string& text);
+    void recordMessages(const std::string& checksName, const std::vector<const LineInfoTy*>& lines);
+    void endFunction(Function *f, unsigned long states); // also saves the checkpoint when it is time to
+    void save();
+};
+
+#endif
@@ -1,5 +1,6 @@
 
 #include "common.h"
+#include "shard.h"
 
 #include <cxxabi.h>
 #include <vector>
@@ -50,6 +51,23 @@ void sortFunctionsByName(FunctionsOrderedSetTy& functionsOfInterestSet, Function
   std::sort(functionsOfInterestVector.begin(), functionsOfInterestVector.end(), FunctionLess);
 }
 
+static Module *readModule = NULL; // module returned by parseArgsReadIR
+static std::vector<std::string> readModuleFiles; // base file, and module file if linked with it
+
+std::string moduleInputName(Module *m) {
+  if (m == readModule) {
+    return readModuleFiles.back();
+  }
+  return m->getModuleIdentifier();
+}
+
+std::vector<std::string> moduleInputFiles(Module *m) {
+  if (m == readModule) {
+    return readModuleFiles;
+  }
+  return std::vector<std::string>(1, m->getModuleIdentifier());
+}
+
 // supported usage
 //   tool
 //     processes R.bin.bc
@@ -60,10 +78,13 @@ void sortFunctionsByName(FunctionsOrderedSetTy& functionsOfInterestSet, Function
 //     from that module (but some tools need to do whole-program analysis
 //     which also will include functions from the base
 //      IR file not included in the module)
+//   tool --shard i/N ...
+//     checks only the i-th of N slices of the functions (see shard.h)
 Module *parseArgsReadIR(int argc, char* argv[], FunctionsOrderedSetTy& functionsOfInterestSet, FunctionsVectorTy& functionsOfInterestVector, LLVMContext& context) {
 
+  parseShardArg(argc, argv);
   if (argc > 3) {
-    errs() << argv[0] << " base_file.bc [module_file.bc]" << "\n";
+    errs() << argv[0] << " [--shard i/N] base_file.bc [module_file.bc]" << "\n";
     exit(1);
   }
 
@@ -89,7 +110,10 @@ Module *parseArgsReadIR(int argc, char* argv[], FunctionsOrderedSetTy& functions
       Function *fun = &*f;
       functionsOfInterestSet.insert(fun);
     }
+    readModule = base;
+    readModuleFiles.assign(1, baseFname);
     sortFunctionsByName(functionsOfInterestSet, functionsOfInterestVector);
+    selectShard(functionsOfInterestSet, functionsOfInterestVector);
     return base;
   }
   
@@ -137,7 +161,10 @@ Module *parseArgsReadIR(int argc, char* argv[], FunctionsOrderedSetTy& functions
     // in package tau), but R has the same symbol as non-function
   }
 
+  readModule = base;
+  readModuleFiles.assign({baseFname, moduleFname});
   sortFunctionsByName(functionsOfInterestSet, functionsOfInterestVector);
+  selectShard(functionsOfInterestSet, functionsOfInterestVector);
   return base;
 }
 
@@ -166,15 +193,18 @@ bool sourceLocation(const Instruction *in, std::string& path, unsigned& line) {
 
   line = debugLoc.getLine();  
   if (DIScope *scope = dyn_cast<DIScope>(debugLoc.getScope())) {
-    if (sys::path::is_absolute(scope->getFilename())) {
-      path = scope->getFilename().str();
-    } else {
-      path = scope->getDirectory().str() + "/" + scope->getFilename().str();
-    }
+    path = scopePath(scope);
   }
   return true;
 }
 
+std::string scopePath(const DIScope *scope) {
+  if (sys::path::is_absolute(scope->getFilename())) {
+    return scope->getFilename().str();
+  }
+  return scope->getDirectory().str() + "/" + scope->getFilename().str();
+}
+
 std::string sourceLocation(const Instruction *in) {
   unsigned line;
   std::string path;
@@ -26,6 +26,10 @@ void myassert_fail (const char *assertion, const char *file, unsigned int line,
   #define TerminatorInst Instruction
 #endif
 
+namespace llvm {
+  class DIScope;
+}
+
 using namespace llvm;
 
 typedef std::unordered_set<BasicBlock*> BasicBlocksSetTy;
@@ -44,10 +48,16 @@ struct VarBoolCacheTy_hash {
 typedef std::unordered_map<AllocaInst*,bool,VarBoolCacheTy_hash> VarBoolCacheTy;
 
 Module *parseArgsReadIR(int argc, char* argv[], FunctionsOrderedSetTy& functionsOfInterestSet, FunctionsVectorTy& functionsOfInterestVector, LLVMContext& context);
+// the input file of module m, i.e. the module file when m is the base linked with it by parseArgsReadIR
+std::string moduleInputName(Module *m);
+// all input files module m has been read from (base file first)
+std::vector<std::string> moduleInputFiles(Module *m);
+void sortFunctionsByName(FunctionsOrderedSetTy& functionsOfInterestSet, FunctionsVectorTy& functionsOfInterestVector);
 
 std::string demangle(std::string name);
 
 bool sourceLocation(const Instruction *in, std::string& path, unsigned& line);
+std::string scopePath(const DIScope *scope); // source file of the debug scope
 std::string sourceLocation(const Instruction *in);
 std::string funLocation(const Function *f);
 std::string instructionAsString(const Instruction *in);
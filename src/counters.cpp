@@ -0,0 +1,103 @@
+
+#include "counters.h"
+
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+const bool countersEnabled = getenv("RCHK_COUNTERS") != NULL;
+
+struct CountersRegistryTy {
+  std::mutex mutex;
+  std::vector<const char*> names; // indexed by counter index
+  std::vector<CounterBlockTy*> blocks; // one per thread that counted, never freed (threads may have ended)
+  std::vector<unsigned long> functionStart;
+};
+
+static CountersRegistryTy& registry() {
+  static CountersRegistryTy r;
+  return r;
+}
+
+CounterTy::CounterTy(const char *name) {
+  CountersRegistryTy& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  myassert(r.names.size() < MAX_COUNTERS);
+  idx = r.names.size();
+  r.names.push_back(name);
+}
+
+CounterBlockTy* newCounterBlock() {
+  CounterBlockTy* block = new CounterBlockTy();
+  for(unsigned i = 0; i < MAX_COUNTERS; i++) {
+    block->counts[i] = 0;
+  }
+  CountersRegistryTy& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.blocks.push_back(block);
+  return block;
+}
+
+// sums of the counts of all threads, the caller holds the lock
+static std::vector<unsigned long> sumCounts(CountersRegistryTy& r) {
+  std::vector<unsigned long> sums(r.names.size(), 0);
+  for(std::vector<CounterBlockTy*>::const_iterator bi = r.blocks.begin(), be = r.blocks.end(); bi != be; ++bi) {
+    for(unsigned i = 0; i < sums.size(); i++) {
+      sums[i] += (*bi)->counts[i];
+    }
+  }
+  return sums;
+}
+
+void startFunctionCounters() {
+  if (!countersEnabled) {
+    return;
+  }
+  CountersRegistryTy& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.functionStart = sumCounts(r);
+}
+
+void printFunctionCounters(const std::string& name) {
+  if (!countersEnabled) {
+    return;
+  }
+  CountersRegistryTy& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  std::vector<unsigned long> sums = sumCounts(r);
+  r.functionStart.resize(sums.size(), 0);
+
+  bool first = true;
+  for(unsigned i = 0; i < sums.size(); i++) {
+    unsigned long delta = sums[i] - r.functionStart[i];
+    if (!delta) {
+      continue;
+    }
+    if (first) {
+      errs() << "Counters for " << name << ":";
+      first = false;
+    }
+    errs() << " " << r.names[i] << "=" << delta << ";";
+  }
+  if (!first) {
+    errs() << "\n";
+  }
+}
+
+void printCounters() {
+  if (!countersEnabled) {
+    return;
+  }
+  CountersRegistryTy& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  std::vector<unsigned long> sums = sumCounts(r);
+
+  errs() << "Counters:\n";
+  for(unsigned i = 0; i < sums.size(); i++) {
+    errs() << "  " << r.names[i] << ": " << sums[i] << "\n";
+  }
+}
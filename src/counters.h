@@ -0,0 +1,53 @@
+#ifndef RCHK_COUNTERS_H
+#define RCHK_COUNTERS_H
+
+#include "common.h"
+
+#include <string>
+
+// counters of events in the hot loops of the checkers, for tuning
+//
+// counting is enabled when environment variable RCHK_COUNTERS is set, the counters are then
+// printed for each checked function (those that changed) and for the whole run; when disabled,
+// counting only tests a global flag
+//
+// counters are defined as (static) globals, so that they are registered before use
+//
+//   static CounterTy loadsCounter("freshvars loads");
+//   ...
+//   loadsCounter.inc();
+//
+// counts are kept per thread (no synchronization in the hot loops) and summed when printed
+
+extern const bool countersEnabled;
+
+const unsigned MAX_COUNTERS = 64;
+
+struct CounterBlockTy {
+  unsigned long counts[MAX_COUNTERS];
+};
+
+CounterBlockTy* newCounterBlock(); // registers a block for the current thread
+
+inline CounterBlockTy& threadCounters() {
+  static thread_local CounterBlockTy* block = newCounterBlock();
+  return *block;
+}
+
+class CounterTy {
+  unsigned idx;
+
+  public:
+    CounterTy(const char *name);
+    void inc(unsigned long n = 1) {
+      if (countersEnabled) {
+        threadCounters().counts[idx] += n;
+      }
+    }
+};
+
+void startFunctionCounters(); // remembers the current counts
+void printFunctionCounters(const std::string& name); // prints counts changed since the start
+void printCounters(); // prints counts of the whole run
+
+#endif
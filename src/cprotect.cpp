@@ -2,19 +2,27 @@
 #include "cprotect.h"
 #include "table.h"
 #include "allocators.h"
+#include "parallel.h"
+#include "dataflow.h"
+#include "moduleindex.h"
+#include "analysiscache.h"
 
+#include <algorithm>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Analysis/CallGraph.h>
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Constants.h>
-#include <llvm/IR/InstIterator.h>
 
 #include <llvm/Support/raw_ostream.h>
 
 using namespace llvm;
 
-typedef std::vector<bool> ArgsTy;
+typedef BitSet ArgsTy;
 typedef IndexedTable<AllocaInst> VarIndexTy;
 typedef IndexedTable<Argument> ArgIndexTy;
 
@@ -55,11 +63,9 @@ struct CProtectFunctionState {
   CProtectFunctionState(Function *fun): fun(fun), exposed(fun->arg_size(), false), usedAfterExposure(fun->arg_size(), false), dirty(false), varIndex(), argIndex(), confused(false) {
 
     // index variables
-    for(inst_iterator ii = inst_begin(*fun), ie = inst_end(*fun); ii != ie; ++ii) {
-      Instruction *in = &*ii;
-      if (AllocaInst* var = dyn_cast<AllocaInst>(in)) {
-        varIndex.indexOf(var);
-      }
+    const FunctionIndexTy& findex = ModuleIndexTy::get(fun->getParent()).getFunction(fun);
+    for(std::vector<AllocaInst*>::const_iterator vi = findex.vars.begin(), ve = findex.vars.end(); vi != ve; ++vi) {
+      varIndex.indexOf(*vi);
     }
     
     // index arguments
@@ -69,31 +75,16 @@ struct CProtectFunctionState {
     }
   }
   
-  bool merge(ArgsTy _exposed, ArgsTy _usedAfterExposure) {
+  bool merge(ArgsTy& _exposed, ArgsTy& _usedAfterExposure) {
 
-    unsigned nargs = _exposed.size();
-    bool updated = false;
-    
-    for(unsigned i = 0; i < nargs; i++) {
-      if (!exposed.at(i) && _exposed.at(i)) {
-        exposed.at(i) = true;
-        updated = true;
-      }
-      if (!usedAfterExposure.at(i) && _usedAfterExposure.at(i)) {
-        usedAfterExposure.at(i) = true;
-        updated = true;
-      }
-    }
+    bool updated = exposed.unionWith(_exposed);
+    updated |= usedAfterExposure.unionWith(_usedAfterExposure);
     return updated;
   }
   
   bool isCalleeProtect() {
 
-    unsigned nargs = exposed.size();
-    for(unsigned i = 0; i < nargs; i++) {
-      if (exposed.at(i)) return false;
-    }
-    return true;
+    return !exposed.any();
   }
   
   bool isNonTriviallyCalleeProtect(FunctionsSetTy& allocatingFunctions) {
@@ -112,17 +103,16 @@ struct CProtectFunctionState {
       return;
     }
     confused = true;
-    unsigned nargs = exposed.size();
-    for(unsigned i = 0; i < nargs; i++) { // conservatively mark all args exposed
-      // this also marks non-SEXP args
-      exposed.at(i) = true;
-      usedAfterExposure.at(i) = true;
-    }
+    // conservatively mark all args exposed
+    //   this also marks non-SEXP args
+    exposed.setAll(true);
+    usedAfterExposure.setAll(true);
   }
 };
 
 typedef std::unordered_map<Function*, CProtectFunctionState> FunctionTableTy;
 typedef std::vector<Function*> FunctionListTy;
+typedef std::vector<FunctionListTy> SCCListTy;
 
 static void addToFunctionWorkList(FunctionListTy& workList, CProtectFunctionState& fstate) {
 
@@ -141,13 +131,11 @@ struct CProtectBlockState {
   ArgsTy exposed;
   ArgsTy usedAfterExposure;
   VarsTy vars;			// argument index (>=0) or -1, when not (surely) an argument value
-  bool dirty;			// block is in worklist, to be processed again
   
-  CProtectBlockState(unsigned nargs, unsigned nvars):
-    pstack(), exposed(nargs, false), usedAfterExposure(nargs, false), vars(nvars, -1), dirty(false) {}
+  CProtectBlockState(): pstack(), exposed(), usedAfterExposure(), vars() {}
   
-  CProtectBlockState(ProtectStackTy pstack, ArgsTy exposed, ArgsTy usedAfterExposure, VarsTy vars, bool dirty):
-    pstack(pstack), exposed(exposed), usedAfterExposure(usedAfterExposure), vars(vars), dirty(dirty) {}
+  CProtectBlockState(unsigned nargs, unsigned nvars):
+    pstack(), exposed(nargs, false), usedAfterExposure(nargs, false), vars(nvars, -1) {}
     
   bool merge(CProtectBlockState& s, CProtectFunctionState& fstate) {
     bool updated = false;
@@ -165,21 +153,9 @@ struct CProtectBlockState {
       }
     }
     
-    unsigned nargs = exposed.size();
-    myassert(nargs == usedAfterExposure.size());
-    myassert(nargs == s.exposed.size());
-    myassert(nargs == s.usedAfterExposure.size());
-    
-    for(unsigned i = 0; i < nargs; i++) {
-      if (!exposed.at(i) && s.exposed.at(i)) {
-        exposed.at(i) = true;
-        updated = true;
-      }
-      if (!usedAfterExposure.at(i) && s.usedAfterExposure.at(i)) {
-        usedAfterExposure.at(i) = true;
-        updated = true;
-      }
-    }
+    myassert(exposed.size() == usedAfterExposure.size());
+    updated |= exposed.unionWith(s.exposed);
+    updated |= usedAfterExposure.unionWith(s.usedAfterExposure);
     
     unsigned nvars = vars.size();
     for (unsigned i = 0; i < nvars; i++) {
@@ -192,29 +168,26 @@ struct CProtectBlockState {
   }
 };
 
-typedef std::unordered_map<BasicBlock*, CProtectBlockState> BlocksTy;
-typedef std::vector<BasicBlock*> BlockWorkListTy;
-
 // calculates which arguments are currently (definitely) protected
-static ArgsTy protectedArgs(ProtectStackTy pstack, unsigned nargs) {
+static ArgsTy protectedArgs(ProtectStackTy& pstack, unsigned nargs) {
 
   ArgsTy protects(nargs, false);
   for(ProtectStackTy::iterator pi = pstack.begin(), pe = pstack.end(); pi != pe; ++pi) {
     int pvalue = *pi;
     
     if (pvalue >= 0) {
-      protects.at(pvalue) = true;
+      protects.set(pvalue);
     }
   }
   
   return protects;
 }
 
-static void dumpArgs(ArgsTy args) {
+static void dumpArgs(ArgsTy& args) {
 
   unsigned nargs = args.size();
   for(unsigned i = 0; i < nargs; i++) {
-    if (args.at(i)) {
+    if (args.get(i)) {
       errs() << " " << std::to_string(i);
     }
   }
@@ -227,7 +200,7 @@ static bool isExposedBitSet(Function *fun, FunctionTableTy& functions, unsigned
   myassert(fsearch != functions.end());
   
   CProtectFunctionState& fstate = fsearch->second;
-  return fstate.exposed.at(aidx);
+  return fstate.exposed.get(aidx);
 }
 
 // note: the case may not be interesting (e.g. non-SEXP argument, not allocating function, that has to be checked extra)
@@ -237,7 +210,7 @@ static bool isUsedAfterExposureBitSet(Function *fun, FunctionTableTy& functions,
   myassert(fsearch != functions.end());
   
   CProtectFunctionState& fstate = fsearch->second;
-  return fstate.usedAfterExposure.at(aidx);
+  return fstate.usedAfterExposure.get(aidx);
 }
 
 static CProtectFunctionState& getFunctionState(FunctionTableTy& functions, Function *f) {
@@ -265,14 +238,17 @@ static bool isSpecialCalleeProtect(Function *fun) {
   return fun->getName() == "Rf_cons" || fun->getName() == "CONS_NR" || fun->getName() == "Rf_NewEnvironment" || fun->getName() == "mkPROMISE";
 }
 
-static void addCallersToWorkList(Function *fun, FunctionTableTy& functions, FunctionListTy& functionsWorkList) {
-  // mark dirty all functions calling this function
+static void addCallersToWorkList(Function *fun, FunctionTableTy& functions, FunctionsSetTy& sccFunctions, FunctionListTy& functionsWorkList) {
+  // mark dirty all functions calling this function (callers outside the SCC are analyzed later)
   for(Value::user_iterator ui = fun->user_begin(), ue = fun->user_end(); ui != ue; ++ui) {
     User *u = *ui;
 
     if (Instruction *in = dyn_cast<Instruction>(u)) {
       if (BasicBlock *bb = dyn_cast<BasicBlock>(in->getParent())) {
         Function *pf = bb->getParent();
+        if (sccFunctions.find(pf) == sccFunctions.end()) {
+          continue;
+        }
         CProtectFunctionState& pstate = getFunctionState(functions, pf);
         addToFunctionWorkList(functionsWorkList, pstate);
         if (DEBUG) errs() << "adding function " << funName(pf) << " to worklist (updated its callee)\n";
@@ -281,69 +257,28 @@ static void addCallersToWorkList(Function *fun, FunctionTableTy& functions, Func
   }
 }
 
-static void analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& functions, FunctionListTy& functionsWorkList, FunctionsSetTy& allocatingFunctions) {
-
-  Function *fun = fstate.fun;
-
-  // these are constant properties of the function
-  if (!hasSEXPArg(fun) || allocatingFunctions.find(fun) == allocatingFunctions.end()) {
-    return; // trivially nothing exposed
-  }
-  if (isSpecialCalleeProtect(fun)) {
-    return; // nothing exposed (hardcoded)
-  }
-  
-  // this can only change from non-confused to confused
-  if (fstate.confused) {
-    return; // the functions is too complicated for the tool
-      // it has already been marked as exposing everything
-  }
-
-  if (DEBUG) errs() << "analyzing function " << funName(fun) << " worklist size " << std::to_string(functionsWorkList.size()) << "\n";
-  if (DEBUG) {
-    errs() << "   exposed ";
-    dumpArgs(fstate.exposed);
-    errs() << "\n";
-    errs() << "   usedAfterExposure ";
-    dumpArgs(fstate.usedAfterExposure);
-    errs() << "\n";
-  }
+static std::mutex messageMutex; // analyses of different SCCs may run concurrently
 
-  // keep copy of the original state to detect changes
-  
-  ArgsTy oldExposed(fstate.exposed);
-  ArgsTy oldUsedAfterExposure(fstate.usedAfterExposure);
+struct CProtectAnalysis {
+  typedef CProtectBlockState StateTy;
+  static const DataflowDirection direction = DF_FORWARD;
   
-  unsigned nvars = fstate.varIndex.size();
-  unsigned nargs = fstate.argIndex.size();
+  CProtectFunctionState& fstate;
+  FunctionTableTy& functions;
+  FunctionsSetTy& allocatingFunctions;
+  ArgsTy& sexpArgs;
+  unsigned nargs;
   
-  for(unsigned i = 0; i < nargs; i++) {
-    fstate.exposed.at(i) = false;
-    fstate.usedAfterExposure.at(i) = false;
-    // could instead use swap, but this is more readable
-  }
+  CProtectAnalysis(CProtectFunctionState& fstate, FunctionTableTy& functions, FunctionsSetTy& allocatingFunctions, ArgsTy& sexpArgs):
+    fstate(fstate), functions(functions), allocatingFunctions(allocatingFunctions), sexpArgs(sexpArgs), nargs(sexpArgs.size()) {};
   
-  ArgsTy sexpArgs(nargs, false);
-  for(unsigned i = 0; i < nargs; i++) {
-    sexpArgs.at(i) = isSEXPParam(fun, i); // is this caching needed?
-  }
-  
-  BlocksTy blocks;
-  BlockWorkListTy workList;
-  
-  BasicBlock *entryb = &fun->getEntryBlock();
-  blocks.insert({entryb, CProtectBlockState(nargs, nvars)}); 
-  workList.push_back(entryb); 
-  
-  while(!workList.empty()) {
-    BasicBlock *bb = workList.back();
-    workList.pop_back();
-    
-    auto bsearch = blocks.find(bb);
-    myassert(bsearch != blocks.end());
-    bsearch->second.dirty = false;
-    CProtectBlockState s = bsearch->second; // copy
+  // returns false when confused (the function is too complicated for the tool)
+  bool transfer(BasicBlock *bb, StateTy& s) {
     
+    if (fstate.confused) {
+      if (CONMSG) errs() << "   confusion after merging into successor";
+      return false;
+    }
     
     for(BasicBlock::iterator ii = bb->begin(), ie = bb->end(); ii != ie; ++ii) {
       Instruction *in = &*ii;
@@ -380,8 +315,8 @@ static void analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& func
             // variable holds a value from an argument
             unsigned aidx = varState;
             myassert(aidx < s.exposed.size() && aidx < s.usedAfterExposure.size());
-            if (s.exposed.at(aidx)) {
-              s.usedAfterExposure.at(aidx) = true;
+            if (s.exposed.get(aidx)) {
+              s.usedAfterExposure.set(aidx);
               // Note: this does not work well for functions that make a value exposed
               //   note that if the loaded value is to be passed to a function that exposes it,
               //   the exposed bit is not yet set, so usedAfterExposure will not be set, either
@@ -402,9 +337,9 @@ static void analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& func
         
         ArgsTy protects = protectedArgs(s.pstack, nargs);
         for(unsigned i = 0; i < nargs; i++) {
-          if (!protects.at(i) && sexpArgs.at(i)) {
-            s.exposed.at(i) = true;
-            s.usedAfterExposure.at(i) = true;
+          if (!protects.get(i) && sexpArgs.get(i)) {
+            s.exposed.set(i);
+            s.usedAfterExposure.set(i);
           }
         }
         continue;
@@ -443,49 +378,49 @@ static void analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& func
           if (!passingArg) {
             continue;
           }
-          passedInCall.at(aidx) = true;
+          passedInCall.set(aidx);
           
           if (!matchedToSEXPArg(tgtAidx, tgtFun)) {
             // the subtle part: an argument may match to ... parameter
             //   the tool does not handle it, so to be safe, we treat the argument as exposed
             //   also if there was e.g. a void* parameter this conservativeness would apply
-            passedToNonSEXPArg.at(aidx) = true;
+            passedToNonSEXPArg.set(aidx);
             continue;
           }
           
           if (isExposedBitSet(tgtFun, functions, tgtAidx)) {
-            exposedInCall.at(aidx) = true;
+            exposedInCall.set(aidx);
           }
           if (isUsedAfterExposureBitSet(tgtFun, functions, tgtAidx)) {
-            usedAfterExposureInCall.at(aidx) = true;
+            usedAfterExposureInCall.set(aidx);
           }
         }
         // first mark all arguments as exposed, but later fix-up for the case when
         //   some of them is passed to a callee-protect function
         for(unsigned i = 0; i < nargs; i++) {
-          if (!sexpArgs.at(i)) {
+          if (!sexpArgs.get(i)) {
             continue;
           }
-          if (protects.at(i)) {
+          if (protects.get(i)) {
             continue; // arg is protected, the callee can do anything
           }
-          if (!passedInCall.at(i)) {
+          if (!passedInCall.get(i)) {
             if (DEBUG) errs() << "argument " << std::to_string(i) << " exposed because not passed to allocating function " << funName(tgtFun) << "\n";
-            s.exposed.at(i) = true; // arg is not passed to the (allocating) function
+            s.exposed.set(i); // arg is not passed to the (allocating) function
           }
-          if (passedToNonSEXPArg.at(i)) {
+          if (passedToNonSEXPArg.get(i)) {
             // be conservative
-            s.exposed.at(i) = true;
-            s.usedAfterExposure.at(i) = true;
+            s.exposed.set(i);
+            s.usedAfterExposure.set(i);
             if (DEBUG) errs() << "argument " << std::to_string(i) << " assumed exposed+usedAfterExposure because passed to non-SEXP parameter of " << funName(tgtFun) << "\n";
           }
           
-          if (exposedInCall.at(i)) {
-            s.exposed.at(i) = true; // not protected, exposed at least through one parameter
+          if (exposedInCall.get(i)) {
+            s.exposed.set(i); // not protected, exposed at least through one parameter
             if (DEBUG) errs() << "   argument " << std::to_string(i) << " is exposed at call to " << funName(tgtFun) << "\n";
           }
-          if (usedAfterExposureInCall.at(i) || passedToNonSEXPArg.at(i)) {
-            s.usedAfterExposure.at(i) = true; // not protected, used after exposure at least through one parameter
+          if (usedAfterExposureInCall.get(i) || passedToNonSEXPArg.get(i)) {
+            s.usedAfterExposure.set(i); // not protected, used after exposure at least through one parameter
             if (DEBUG) errs() << "   argument " << std::to_string(i) << " is used after exposure at call to " << funName(tgtFun) << "\n";
           }
         }
@@ -519,10 +454,12 @@ static void analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& func
           s.pstack.push_back(protValue);
           if (DEBUG) errs() << "pushing value " << std::to_string(protValue) << " to protect stack " << sourceLocation(in) << "\n";
         } else {
-          errs() << "maximum stack depth reached (treating as confusion)\n";
+          {
+            std::lock_guard<std::mutex> lock(messageMutex);
+            errs() << "maximum stack depth reached (treating as confusion)\n";
+          }
           fstate.markConfused();
-          addCallersToWorkList(fun, functions, functionsWorkList);
-          return;
+          return false;
         }
         continue;
       }
@@ -541,50 +478,81 @@ static void analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& func
           if (ival) {
             if (CONMSG) errs() << "   confusion: unprotecting more values than protected\n";
             fstate.markConfused();
-            addCallersToWorkList(fun, functions, functionsWorkList);
-            return;
+            return false;
           }
           
         } else {
           if (CONMSG) errs() << "   confusion: unsupported form of unprotect " << sourceLocation(in) << "\n";
           fstate.markConfused();
-          addCallersToWorkList(fun, functions, functionsWorkList);
-          return;
+          return false;
         }
       }
     }
     
-    TerminatorInst *t = bb->getTerminator();
-    for(int i = 0, nsucc = t->getNumSuccessors(); i < nsucc; i++) {
-      BasicBlock *succ = t->getSuccessor(i);
-      auto ssearch = blocks.find(succ);
-      if (ssearch == blocks.end()) {
-      
-        // not yet explored block
-        CProtectBlockState sstate(s.pstack, s.exposed, s.usedAfterExposure, s.vars, true /* dirty */);
-        blocks.insert({succ, sstate});
-        workList.push_back(succ);
-
-      } else {
-        CProtectBlockState& pstate = ssearch->second;
-        
-        // merge
-        if (pstate.merge(s, fstate) && !pstate.dirty) {
-          if (fstate.confused) {
-            if (CONMSG) errs() << "   confusion after merging into successor";
-            fstate.markConfused();
-            addCallersToWorkList(fun, functions, functionsWorkList);
-            return;
-          }
-          pstate.dirty = true;
-          workList.push_back(succ);
-        }
-      }
-    }
-  
-    if (ReturnInst::classof(t)) {
+    if (ReturnInst::classof(bb->getTerminator())) {
       fstate.merge(s.exposed, s.usedAfterExposure);
     }
+    return true;
+  }
+  
+  bool join(StateTy& dst, StateTy& src) {
+    return dst.merge(src, fstate);
+  }
+};
+
+static DataflowStatsTy cprotectStats("callee-protect");
+
+// returns true when the summary (exposed, usedAfterExposure) of the function has changed
+static bool analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& functions, FunctionsSetTy& allocatingFunctions) {
+
+  Function *fun = fstate.fun;
+
+  // these are constant properties of the function
+  if (!hasSEXPArg(fun) || allocatingFunctions.find(fun) == allocatingFunctions.end()) {
+    return false; // trivially nothing exposed
+  }
+  if (isSpecialCalleeProtect(fun)) {
+    return false; // nothing exposed (hardcoded)
+  }
+  
+  // this can only change from non-confused to confused
+  if (fstate.confused) {
+    return false; // the functions is too complicated for the tool
+      // it has already been marked as exposing everything
+  }
+
+  if (DEBUG) errs() << "analyzing function " << funName(fun) << "\n";
+  if (DEBUG) {
+    errs() << "   exposed ";
+    dumpArgs(fstate.exposed);
+    errs() << "\n";
+    errs() << "   usedAfterExposure ";
+    dumpArgs(fstate.usedAfterExposure);
+    errs() << "\n";
+  }
+
+  // keep copy of the original state to detect changes
+  
+  ArgsTy oldExposed(fstate.exposed);
+  ArgsTy oldUsedAfterExposure(fstate.usedAfterExposure);
+  
+  unsigned nvars = fstate.varIndex.size();
+  unsigned nargs = fstate.argIndex.size();
+  
+  fstate.exposed.setAll(false);
+  fstate.usedAfterExposure.setAll(false);
+  
+  ArgsTy sexpArgs(nargs, false);
+  for(unsigned i = 0; i < nargs; i++) {
+    sexpArgs.set(i, isSEXPParam(fun, i)); // is this caching needed?
+  }
+  
+  CProtectAnalysis analysis(fstate, functions, allocatingFunctions, sexpArgs);
+  DataflowSolver<CProtectAnalysis> solver(fun, analysis, &cprotectStats);
+  solver.seed(&fun->getEntryBlock(), CProtectBlockState(nargs, nvars));
+  
+  if (!solver.solve()) {
+    fstate.markConfused();
   }
 
   if (DEBUG) errs() << "done analyzing function " << funName(fun) << "\n";
@@ -598,15 +566,143 @@ static void analyzeFunction(CProtectFunctionState& fstate, FunctionTableTy& func
   }
 
   if (fstate.exposed != oldExposed || fstate.usedAfterExposure != oldUsedAfterExposure) {
-    if (DEBUG) errs() << "adding callers of " << funName(fun) << " to worklist, because " << funName(fun) << " analysis has changed.\n";
-    addCallersToWorkList(fun, functions, functionsWorkList);
+    if (DEBUG) errs() << "analysis of " << funName(fun) << " has changed.\n";
+    return true;
   }
+  return false;
+}
+
+// iterate the analysis of functions in a strongly connected component of the call graph
+//   to a fixpoint; the callees outside the component have already been analyzed
+static void analyzeSCC(FunctionListTy& scc, FunctionTableTy& functions, FunctionsSetTy& allocatingFunctions) {
+
+  FunctionsSetTy sccFunctions(scc.begin(), scc.end());
+  FunctionListTy workList;
+
+  for(FunctionListTy::reverse_iterator fi = scc.rbegin(), fe = scc.rend(); fi != fe; ++fi) {
+    addToFunctionWorkList(workList, getFunctionState(functions, *fi));
+  }
+
+  while(!workList.empty()) {
+    CProtectFunctionState& fstate = getFunctionState(functions, workList.back());
+    workList.pop_back();
+    fstate.dirty = false;
+
+    if (analyzeFunction(fstate, functions, allocatingFunctions)) {
+      if (DEBUG) errs() << "adding callers of " << funName(fstate.fun) << " to worklist, because " << funName(fstate.fun) << " analysis has changed.\n";
+      addCallersToWorkList(fstate.fun, functions, sccFunctions, workList);
+    }
+  }
+}
+
+// strongly connected components of the call graph grouped by level: a component only calls
+//   components of lower levels (and itself), so components of the same level are independent
+static std::vector<SCCListTy> callGraphLevels(Module *m) {
+
+  CallGraph cg(*m);
+  std::unordered_map<Function*, unsigned> levelMap;
+  std::vector<SCCListTy> levels;
+
+  // scc_iterator provides callees before callers
+  for(scc_iterator<CallGraph*> si = scc_begin(&cg); !si.isAtEnd(); ++si) {
+    const std::vector<CallGraphNode*>& nodes = *si;
+
+    FunctionListTy scc;
+    unsigned level = 0;
+    for(std::vector<CallGraphNode*>::const_iterator ni = nodes.begin(), ne = nodes.end(); ni != ne; ++ni) {
+      CallGraphNode *node = *ni;
+      Function *f = node->getFunction();
+      if (!f) {
+        continue; // external node
+      }
+      scc.push_back(f);
+      for(CallGraphNode::iterator ci = node->begin(), ce = node->end(); ci != ce; ++ci) {
+        Function *callee = ci->second->getFunction();
+        if (!callee) {
+          continue;
+        }
+        auto lsearch = levelMap.find(callee);
+        if (lsearch != levelMap.end() && lsearch->second + 1 > level) { // functions of this SCC are not in the map yet
+          level = lsearch->second + 1;
+        }
+      }
+    }
+    if (scc.empty()) {
+      continue;
+    }
+    for(FunctionListTy::iterator fi = scc.begin(), fe = scc.end(); fi != fe; ++fi) {
+      levelMap.insert({*fi, level});
+    }
+    if (level >= levels.size()) {
+      levels.resize(level + 1);
+    }
+    levels.at(level).push_back(scc);
+  }
+  return levels;
+}
+
+// the cached result has one line per function, with the function name and a digit (CPKind) per
+//   argument; the set of allocating functions is part of the analysis name
+
+static bool loadCalleeProtectFunctions(Module *m, const std::string& analysis, CProtectInfo& cprotect) {
+
+  std::vector<std::string> lines;
+  if (!loadCachedLines(m, analysis, lines)) {
+    return false;
+  }
+
+  CPMapTy loaded;
+  for(std::vector<std::string>::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    std::pair<StringRef, StringRef> split = StringRef(*li).split('\t');
+    Function *fun = m->getFunction(split.first);
+    if (!fun || loaded.find(fun) != loaded.end()) {
+      errs() << "Ignoring invalid analysis cache " << analysis << ": " << *li << "\n";
+      return false;
+    }
+    CPArgsTy cpargs;
+    for(StringRef::iterator ci = split.second.begin(), ce = split.second.end(); ci != ce; ++ci) {
+      if (*ci < '0' || *ci > '0' + CP_TRIVIAL) {
+        errs() << "Ignoring invalid analysis cache " << analysis << ": " << *li << "\n";
+        return false;
+      }
+      cpargs.push_back((CPKind) (*ci - '0'));
+    }
+    loaded.insert({fun, cpargs});
+  }
+  if (loaded.size() != m->size()) {
+    errs() << "Ignoring incomplete analysis cache " << analysis << "\n";
+    return false;
+  }
+  cprotect.map.swap(loaded);
+  return true;
+}
+
+static void saveCalleeProtectFunctions(Module *m, const std::string& analysis, const CProtectInfo& cprotect) {
+
+  std::vector<std::string> lines;
+  for(CPMapTy::const_iterator fi = cprotect.map.begin(), fe = cprotect.map.end(); fi != fe; ++fi) {
+    if (m->getFunction(fi->first->getName()) != fi->first) {
+      return; // cannot be found by name
+    }
+    std::string line = fi->first->getName().str() + "\t";
+    for(CPArgsTy::const_iterator ai = fi->second.begin(), ae = fi->second.end(); ai != ae; ++ai) {
+      line += (char) ('0' + *ai);
+    }
+    lines.push_back(line);
+  }
+  std::sort(lines.begin(), lines.end()); // so that the file does not depend on pointer values
+  saveCachedLines(m, analysis, lines);
 }
 
 CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFunctions) {
 
+  std::string analysis = "calleeprotect-" + functionsSetId(allocatingFunctions);
+  CProtectInfo cprotect;
+  if (loadCalleeProtectFunctions(m, analysis, cprotect)) {
+    return cprotect;
+  }
+
   FunctionTableTy functions; // function envelopes
-  FunctionListTy workList; // functions to be re-analyzed
   
   if (DEBUG) errs() << "adding functions..\n";
   for(Module::iterator fi = m->begin(), fe = m->end(); fi != fe; ++fi) {
@@ -614,22 +710,20 @@ CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFun
     CProtectFunctionState fstate(f);
     auto finsert = functions.insert({f, fstate});
     myassert(finsert.second);
-    addToFunctionWorkList(workList, fstate);
   }
-  
-  while(!workList.empty()) {
-    CProtectFunctionState& fstate = getFunctionState(functions, workList.back());
-    workList.pop_back();
-    if (DEBUG) errs() << "size functions=" << functions.size() << " workList=" << workList.size() << "\n";
+    // from now on, the table is only modified in-place, so it can be read concurrently
 
-    analyzeFunction(fstate, functions, workList, allocatingFunctions);
-    fstate.dirty = false;
-      // a function may be recursive
-      //   but then it does not have to be re-analyzed just because of 
-      //   that it has been re-analyzed
-  }  
+  // analyze bottom-up, so that callees are analyzed (to a fixpoint) before their callers
+  std::vector<SCCListTy> levels = callGraphLevels(m);
+  for(std::vector<SCCListTy>::iterator li = levels.begin(), le = levels.end(); li != le; ++li) {
+    SCCListTy& sccs = *li;
+    if (DEBUG) errs() << "level with " << sccs.size() << " SCCs\n";
+
+    parallelFor(sccs.size(), [&](unsigned i) {
+      analyzeSCC(sccs.at(i), functions, allocatingFunctions);
+    }, DEBUG ? 1 : getNumThreads());
+  }
   
-  CProtectInfo cprotect;
   for(FunctionTableTy::iterator fi = functions.begin(), fe = functions.end(); fi != fe; ++fi) {
     Function* fun = fi->first;
     CProtectFunctionState& fstate = fi->second;
@@ -643,8 +737,8 @@ CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFun
         cpargs.at(i) = CP_TRIVIAL;
         continue;
       }
-      if (fstate.exposed.at(i)) {
-        if (!fstate.usedAfterExposure.at(i)) {
+      if (fstate.exposed.get(i)) {
+        if (!fstate.usedAfterExposure.get(i)) {
           cpargs.at(i) = CP_CALLEE_SAFE;
         } else {
           cpargs.at(i) = CP_CALLER_PROTECT;
@@ -656,6 +750,7 @@ CProtectInfo findCalleeProtectFunctions(Module *m, FunctionsSetTy& allocatingFun
     cprotect.map.insert({fun, cpargs});
   }
 
+  saveCalleeProtectFunctions(m, analysis, cprotect);
   return cprotect;
 }
 
@@ -21,6 +21,8 @@
 #include <llvm/Support/raw_ostream.h>
 
 #include "callocators.h"
+#include "deadline.h"
+#include "counters.h"
 #include "lannotate.h"
 
 using namespace llvm;
@@ -35,30 +37,26 @@ int main(int argc, char* argv[])
   CalledModuleTy *cm = CalledModuleTy::create(m);
 
   const CallSiteTargetsTy *callSiteTargets = cm->getCallSiteTargets();
-  const CalledFunctionsSetTy *allocatingCFunctions = cm->getAllocatingCFunctions();
   
   LinesTy sfpLines;
   
-  for(CallSiteTargetsTy::const_iterator ci = callSiteTargets->begin(), ce = callSiteTargets->end(); ci != ce; ++ci) {
-    Value *inst = ci->first;
-    Function *csFun = cast<Instruction>(inst)->getParent()->getParent();
+  for(unsigned id = 0, nsites = callSiteTargets->size(); id < nsites; id++) {
+    if (!callSiteTargets->mayCallGC(id)) {
+      continue;
+    }
+    Instruction *inst = cast<Instruction>(callSiteTargets->getCallSite(id));
+    Function *csFun = inst->getParent()->getParent();
     if (functionsOfInterestSet.find(csFun) == functionsOfInterestSet.end()) {
         continue;
     }
-    const CalledFunctionsSetTy& funcs = ci->second;
-    
-    for(CalledFunctionsSetTy::const_iterator fi = funcs.begin(), fe = funcs.end(); fi != fe; ++fi) {
-      const CalledFunctionTy *f = *fi;
-      
-      if (allocatingCFunctions->find(f) != allocatingCFunctions->end()) {
-        annotateLine(sfpLines, cast<Instruction>(inst));
-      }
-    }
+    annotateLine(sfpLines, inst);
   }
 
   printLineAnnotations(sfpLines);
   
   CalledModuleTy::release(cm);  
   delete m;
+  printTimeouts();
+  printCounters();
 }  
 
@@ -0,0 +1,71 @@
+
+#include "dataflow.h"
+
+#include <cstdlib>
+
+#include <llvm/ADT/PostOrderIterator.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+BlockNumbering::BlockNumbering(Function *f): blocks(), numbers() {
+
+  if (f->empty()) {
+    return;
+  }
+
+  ReversePostOrderTraversal<Function*> rpot(f);
+  for(ReversePostOrderTraversal<Function*>::rpo_iterator bi = rpot.begin(), be = rpot.end(); bi != be; ++bi) {
+    BasicBlock *bb = *bi;
+    numbers.insert({bb, (unsigned) blocks.size()});
+    blocks.push_back(bb);
+  }
+
+  // unreachable blocks (they may still be predecessors of reachable ones)
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    if (numbers.find(bb) == numbers.end()) {
+      numbers.insert({bb, (unsigned) blocks.size()});
+      blocks.push_back(bb);
+    }
+  }
+}
+
+static std::vector<DataflowStatsTy*>& statsRegistry() {
+  static std::vector<DataflowStatsTy*> registry;
+  return registry;
+}
+
+DataflowStatsTy::DataflowStatsTy(std::string name): name(name), functions(0), blocks(0), iterations(0), maxMutex(), maxIterations(0), maxFunction() {
+  statsRegistry().push_back(this);
+}
+
+void DataflowStatsTy::record(Function *f, unsigned nblocks, unsigned niterations) {
+  functions++;
+  blocks += nblocks;
+  iterations += niterations;
+
+  std::lock_guard<std::mutex> lock(maxMutex);
+  if (niterations > maxIterations) {
+    maxIterations = niterations;
+    maxFunction = funName(f);
+  }
+}
+
+void printDataflowStats() {
+
+  if (!getenv("RCHK_DATAFLOW_STATS")) {
+    return;
+  }
+  std::vector<DataflowStatsTy*>& registry = statsRegistry();
+  for(std::vector<DataflowStatsTy*>::iterator si = registry.begin(), se = registry.end(); si != se; ++si) {
+    DataflowStatsTy& s = **si;
+    if (!s.functions) {
+      continue;
+    }
+    errs() << "Dataflow " << s.name << ": " << s.functions.load() << " function runs, " << s.blocks.load() << " blocks, "
+      << s.iterations.load() << " block iterations (" << format("%.2f", s.blocks ? (double) s.iterations / s.blocks : 0.0) << " per block), "
+      << "at most " << s.maxIterations << " in " << s.maxFunction << "\n";
+  }
+}
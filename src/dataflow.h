@@ -0,0 +1,287 @@
+#ifndef RCHK_DATAFLOW_H
+#define RCHK_DATAFLOW_H
+
+#include "common.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Function.h>
+
+using namespace llvm;
+
+// a simple intra-procedural dataflow framework
+//
+// blocks of a function are numbered densely (in reverse post-order), block
+// states are kept in a vector indexed by block number, and the worklist is
+// a bitset of block numbers: the lowest-numbered block is processed first
+// in forward analyses (reverse post-order), the highest-numbered in
+// backward analyses (post-order)
+
+// fixed-size bitset with word-wide operations
+
+class BitSet {
+
+  typedef uint64_t WordTy;
+  static const unsigned WORD_BITS = 64;
+
+  std::vector<WordTy> words;
+  unsigned nbits;
+
+  static unsigned nwords(unsigned nbits) { return (nbits + WORD_BITS - 1) / WORD_BITS; }
+
+  void clearUnusedBits() {
+    unsigned rem = nbits % WORD_BITS;
+    if (rem) {
+      words.back() &= (((WordTy) 1) << rem) - 1;
+    }
+  }
+
+  public:
+    BitSet(): words(), nbits(0) {}
+    BitSet(unsigned nbits, bool value = false): words(nwords(nbits), value ? ~((WordTy) 0) : 0), nbits(nbits) {
+      clearUnusedBits();
+    }
+
+    unsigned size() const { return nbits; }
+
+    bool get(unsigned i) const {
+      myassert(i < nbits);
+      return (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+    }
+
+    void set(unsigned i, bool value = true) {
+      myassert(i < nbits);
+      WordTy mask = ((WordTy) 1) << (i % WORD_BITS);
+      if (value) {
+        words[i / WORD_BITS] |= mask;
+      } else {
+        words[i / WORD_BITS] &= ~mask;
+      }
+    }
+
+    void reset(unsigned i) { set(i, false); }
+
+    void setAll(bool value) {
+      for(unsigned w = 0, nw = words.size(); w < nw; w++) {
+        words[w] = value ? ~((WordTy) 0) : 0;
+      }
+      clearUnusedBits();
+    }
+
+    bool any() const {
+      for(unsigned w = 0, nw = words.size(); w < nw; w++) {
+        if (words[w]) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // this |= other, returns true if this has changed
+    bool unionWith(const BitSet& other) {
+      myassert(nbits == other.nbits);
+      WordTy changed = 0;
+      for(unsigned w = 0, nw = words.size(); w < nw; w++) {
+        WordTy old = words[w];
+        words[w] |= other.words[w];
+        changed |= old ^ words[w];
+      }
+      return changed != 0;
+    }
+
+    // this &= other, returns true if this has changed
+    bool intersectWith(const BitSet& other) {
+      myassert(nbits == other.nbits);
+      WordTy changed = 0;
+      for(unsigned w = 0, nw = words.size(); w < nw; w++) {
+        WordTy old = words[w];
+        words[w] &= other.words[w];
+        changed |= old ^ words[w];
+      }
+      return changed != 0;
+    }
+
+    // index of the lowest set bit, or size() when none
+    unsigned findFirst() const {
+      for(unsigned w = 0, nw = words.size(); w < nw; w++) {
+        if (words[w]) {
+          return w * WORD_BITS + __builtin_ctzll(words[w]);
+        }
+      }
+      return nbits;
+    }
+
+    // index of the highest set bit, or size() when none
+    unsigned findLast() const {
+      for(unsigned w = words.size(); w > 0; w--) {
+        if (words[w - 1]) {
+          return (w - 1) * WORD_BITS + (WORD_BITS - 1 - __builtin_clzll(words[w - 1]));
+        }
+      }
+      return nbits;
+    }
+
+    bool operator==(const BitSet& other) const { return nbits == other.nbits && words == other.words; }
+    bool operator!=(const BitSet& other) const { return !(*this == other); }
+
+    size_t hash() const {
+      size_t res = nbits;
+      for(unsigned w = 0, nw = words.size(); w < nw; w++) {
+        hash_combine(res, (size_t) words[w]);
+      }
+      return res;
+    }
+};
+
+// dense numbering of basic blocks of a function, blocks reachable from the
+// entry come first in reverse post-order, then unreachable blocks
+
+class BlockNumbering {
+
+  std::vector<BasicBlock*> blocks;
+  DenseMap<BasicBlock*, unsigned> numbers;
+
+  public:
+    BlockNumbering(Function *f);
+
+    unsigned size() const { return blocks.size(); }
+    BasicBlock* at(unsigned idx) const { return blocks[idx]; }
+    unsigned indexOf(BasicBlock *bb) const {
+      auto nsearch = numbers.find(bb);
+      myassert(nsearch != numbers.end());
+      return nsearch->second;
+    }
+};
+
+// statistics on how many times blocks are processed, per analysis
+
+struct DataflowStatsTy {
+  std::string name;
+  std::atomic<unsigned long> functions;
+  std::atomic<unsigned long> blocks;
+  std::atomic<unsigned long> iterations;
+
+  std::mutex maxMutex;
+  unsigned long maxIterations; // in a single function
+  std::string maxFunction;
+
+  DataflowStatsTy(std::string name);
+  void record(Function *f, unsigned nblocks, unsigned niterations);
+};
+
+// prints statistics of all analyses, when enabled via environment variable RCHK_DATAFLOW_STATS
+void printDataflowStats();
+
+enum DataflowDirection {
+  DF_FORWARD = 0,
+  DF_BACKWARD
+};
+
+// the analysis plugin provides:
+//
+//   typedef ... StateTy;  (default constructible, copyable)
+//   static const DataflowDirection direction;
+//
+//   bool transfer(BasicBlock *bb, StateTy& s);
+//     applies the block to state s (in the direction of the analysis), returns false to stop the analysis
+//
+//   bool join(StateTy& dst, StateTy& src);
+//     merges src into dst, returns true when dst has changed
+//
+// the states kept are at block entry for forward analyses and at block exit for backward analyses
+
+template <class Analysis> class DataflowSolver {
+
+  typedef typename Analysis::StateTy StateTy;
+
+  Function *fun;
+  Analysis& analysis;
+  BlockNumbering numbering;
+  std::vector<StateTy> states;
+  BitSet reached;
+  BitSet pending;
+  unsigned iterations;
+  DataflowStatsTy *stats;
+
+  // returns the number of blocks when the worklist is empty
+  unsigned pop() {
+    unsigned idx = (Analysis::direction == DF_FORWARD) ? pending.findFirst() : pending.findLast();
+    if (idx < pending.size()) {
+      pending.reset(idx);
+    }
+    return idx;
+  }
+
+  void propagate(unsigned idx, StateTy& s) {
+    if (!reached.get(idx)) {
+      states[idx] = s;
+      reached.set(idx);
+      pending.set(idx);
+      return;
+    }
+    if (analysis.join(states[idx], s)) {
+      pending.set(idx);
+    }
+  }
+
+  public:
+    DataflowSolver(Function *f, Analysis& analysis, DataflowStatsTy *stats = NULL):
+      fun(f), analysis(analysis), numbering(f), states(numbering.size()), reached(numbering.size()), pending(numbering.size()),
+      iterations(0), stats(stats) {}
+
+    // set (or merge in) the initial state of a boundary block
+    void seed(BasicBlock *bb, StateTy s) {
+      propagate(numbering.indexOf(bb), s);
+    }
+
+    // returns false iff the analysis has been stopped by the transfer function
+    bool solve() {
+      bool completed = true;
+      unsigned nblocks = numbering.size();
+
+      for(;;) {
+        unsigned idx = pop();
+        if (idx == nblocks) {
+          break;
+        }
+        BasicBlock *bb = numbering.at(idx);
+        StateTy s = states[idx]; // copy
+        iterations++;
+
+        if (!analysis.transfer(bb, s)) {
+          completed = false;
+          break;
+        }
+
+        if (Analysis::direction == DF_FORWARD) {
+          TerminatorInst *t = bb->getTerminator();
+          for(int i = 0, nsucc = t->getNumSuccessors(); i < nsucc; i++) {
+            propagate(numbering.indexOf(t->getSuccessor(i)), s);
+          }
+        } else {
+          for(pred_iterator pi = pred_begin(bb), pe = pred_end(bb); pi != pe; ++pi) {
+            propagate(numbering.indexOf(*pi), s);
+          }
+        }
+      }
+
+      if (stats) {
+        stats->record(fun, nblocks, iterations);
+      }
+      return completed;
+    }
+
+    bool isReached(BasicBlock *bb) const { return reached.get(numbering.indexOf(bb)); }
+    StateTy& getState(BasicBlock *bb) { return states[numbering.indexOf(bb)]; }
+    const BlockNumbering& getBlocks() const { return numbering; }
+    unsigned getIterations() const { return iterations; }
+};
+
+#endif
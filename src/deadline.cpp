@@ -0,0 +1,129 @@
+
+#include "deadline.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <mutex>
+#include <vector>
+
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+static const std::chrono::steady_clock::time_point moduleStart = std::chrono::steady_clock::now();
+
+static double timeoutFromEnv(const char *name) {
+  const char *env = getenv(name);
+  if (!env) {
+    return 0;
+  }
+  double seconds = atof(env);
+  return (seconds > 0) ? seconds : 0;
+}
+
+static double functionTimeout() {
+  static double seconds = timeoutFromEnv("RCHK_FUNCTION_TIMEOUT");
+  return seconds;
+}
+
+static double moduleTimeout() {
+  static double seconds = timeoutFromEnv("RCHK_MODULE_TIMEOUT");
+  return seconds;
+}
+
+static std::chrono::steady_clock::duration toDuration(double seconds) {
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+void DeadlineTy::startFunction() {
+
+  start = ClockTy::now();
+  countdown = CHECK_INTERVAL;
+  enabled = functionTimeout() || moduleTimeout();
+  if (!enabled) {
+    return;
+  }
+  end = ClockTy::time_point::max();
+  if (functionTimeout()) {
+    end = start + toDuration(functionTimeout());
+  }
+  if (moduleTimeout()) {
+    ClockTy::time_point moduleEnd = moduleStart + toDuration(moduleTimeout());
+    if (moduleEnd < end) {
+      end = moduleEnd;
+    }
+  }
+}
+
+bool DeadlineTy::expired() {
+
+  if (!enabled) {
+    return false;
+  }
+  if (--countdown) {
+    return false;
+  }
+  countdown = CHECK_INTERVAL;
+  return ClockTy::now() >= end;
+}
+
+double DeadlineTy::elapsed() const {
+  return std::chrono::duration<double>(ClockTy::now() - start).count();
+}
+
+bool moduleDeadlineExpired() {
+  return moduleTimeout() && std::chrono::steady_clock::now() >= moduleStart + toDuration(moduleTimeout());
+}
+
+static std::mutex timeoutsMutex;
+static std::vector<std::string> timeouts;
+
+void recordTimeout(Function *fun, const std::string& what, double seconds) {
+
+  std::string line;
+  raw_string_ostream os(line);
+  os << funName(fun) << "\t" << what << "\t" << format("%.1f", seconds) << "s";
+  os.flush();
+
+  std::lock_guard<std::mutex> lock(timeoutsMutex);
+  timeouts.push_back(line);
+}
+
+unsigned numberOfTimeouts() {
+
+  std::lock_guard<std::mutex> lock(timeoutsMutex);
+  return timeouts.size();
+}
+
+void recordModuleTimeout(unsigned nskipped) {
+
+  std::lock_guard<std::mutex> lock(timeoutsMutex);
+  timeouts.push_back("<module>\t" + std::to_string(nskipped) + " functions not checked\t" + std::to_string((unsigned) moduleTimeout()) + "s");
+}
+
+void printTimeouts() {
+
+  std::lock_guard<std::mutex> lock(timeoutsMutex);
+  if (timeouts.empty()) {
+    return;
+  }
+
+  const char *fname = getenv("RCHK_TIMEOUTS");
+  if (fname && *fname) {
+    int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd >= 0) {
+      raw_fd_ostream out(fd, true);
+      for(std::vector<std::string>::const_iterator ti = timeouts.begin(), te = timeouts.end(); ti != te; ++ti) {
+        out << *ti << "\n";
+      }
+      return;
+    }
+    errs() << "Cannot write timeouts to " << fname << "\n";
+  }
+
+  errs() << "Timeouts (function, checking, time spent):\n";
+  for(std::vector<std::string>::const_iterator ti = timeouts.begin(), te = timeouts.end(); ti != te; ++ti) {
+    errs() << "  " << *ti << "\n";
+  }
+}
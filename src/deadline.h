@@ -0,0 +1,49 @@
+#ifndef RCHK_DEADLINE_H
+#define RCHK_DEADLINE_H
+
+#include "common.h"
+
+#include <chrono>
+#include <string>
+
+// time budgets for the path-sensitive checking, set via environment variables (in seconds)
+//
+//   RCHK_FUNCTION_TIMEOUT  for checking a single function
+//   RCHK_MODULE_TIMEOUT    for the whole run (functions not checked when exhausted)
+//
+// functions that ran out of time are recorded and listed at the end of the run
+// (to the file given by RCHK_TIMEOUTS, or to the error output)
+
+class DeadlineTy {
+
+  typedef std::chrono::steady_clock ClockTy;
+
+  static const unsigned CHECK_INTERVAL = 256; // polls between reading the clock
+
+  bool enabled;
+  ClockTy::time_point start;
+  ClockTy::time_point end;
+  unsigned countdown;
+
+  public:
+    DeadlineTy(): enabled(false), start(), end(), countdown(0) {}
+
+    void startFunction(); // starts the budget of a function (bounded by the module budget)
+    bool expired(); // cheap, to be polled from exploration loops
+    double elapsed() const; // seconds since start of the function
+};
+
+bool moduleDeadlineExpired();
+
+// records a function that ran out of time; what is the kind of checking
+void recordTimeout(Function *fun, const std::string& what, double seconds);
+
+// number of timeouts recorded so far (results computed meanwhile depend on timing)
+unsigned numberOfTimeouts();
+
+// records that the module budget ran out with nskipped functions not checked
+void recordModuleTimeout(unsigned nskipped);
+
+void printTimeouts();
+
+#endif
@@ -16,6 +16,8 @@
 #include <llvm/Support/raw_ostream.h>
 
 #include "errors.h"
+#include "dataflow.h"
+#include "shard.h"
 
 using namespace llvm;
 
@@ -42,14 +44,17 @@ int main(int argc, char* argv[])
       if (fun->doesNotReturn()) {
         errs() << "Marked (noreturn) error function " << funName(fun) << " " << funLocation(fun) << "\n";
       } else {
+        printShardMarker(outs(), fun);
         outs() << "UNMARKED error function " << funName(fun) << " " << funLocation(fun) << "\n";
       }
 
     } else {
       if (fun->doesNotReturn()) {
+        printShardMarker(outs(), fun);
         outs() << "WARNING - returning function marked noerror - " << funName(fun) << " " << funLocation(fun) << "\n";
       }
     }
   }
   delete m;
+  printDataflowStats();
 } 
@@ -1,11 +1,55 @@
 
 #include "errors.h"
+#include "analysiscache.h"
+#include "dataflow.h"
+#include "moduleindex.h"
 
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Instructions.h>
 
 using namespace llvm;
 
+// backward analysis of which blocks can reach a (non-error) return
+
+struct ReturningStateTy {
+  bool returning; // a return is reachable from the end of the block
+  
+  ReturningStateTy(): returning(false) {};
+  ReturningStateTy(bool returning): returning(returning) {};
+};
+
+struct ReturningBlocksAnalysis {
+  typedef ReturningStateTy StateTy;
+  static const DataflowDirection direction = DF_BACKWARD;
+  
+  BasicBlocksSetTy& errorBlocks;
+  BasicBlock *entry;
+  bool onlyCheck;
+  
+  ReturningBlocksAnalysis(BasicBlocksSetTy& errorBlocks, BasicBlock *entry, bool onlyCheck):
+    errorBlocks(errorBlocks), entry(entry), onlyCheck(onlyCheck) {};
+  
+  bool transfer(BasicBlock *bb, StateTy& s) {
+    if (errorBlocks.find(bb) != errorBlocks.end()) {
+      s.returning = false;
+    }
+    if (onlyCheck && s.returning && bb == entry) {
+      return false; // not an error function, no need to look further
+    }
+    return true;
+  }
+  
+  bool join(StateTy& dst, StateTy& src) {
+    if (!dst.returning && src.returning) {
+      dst.returning = true;
+      return true;
+    }
+    return false;
+  }
+};
+
+static DataflowStatsTy errorsStats("error blocks");
+
 // returns true iff the function is an error function
 static bool checkAndAnalyzeErrorFunction(Function *fun, FunctionsSetTy *knownErrorFunctions, BasicBlocksSetTy& returningBlocks, bool onlyCheck) {
 
@@ -14,63 +58,56 @@ static bool checkAndAnalyzeErrorFunction(Function *fun, FunctionsSetTy *knownErr
     return false;
   }
   BasicBlocksSetTy errorBlocks;
+  BasicBlocksSetTy returnBlocks;
   BasicBlock *entry = &fun->getEntryBlock();
+  const FunctionIndexTy& findex = ModuleIndexTy::get(fun->getParent()).getFunction(fun);
 
-  for(Function::iterator bb = fun->begin(), bbe = fun->end(); bb != bbe; ++bb) {
-    if (UnreachableInst::classof(bb->getTerminator())) {
+  for(std::vector<IndexedBlockTy>::const_iterator bi = findex.blocks.begin(), be = findex.blocks.end(); bi != be; ++bi) {
+    BasicBlock *bb = bi->bb;
+    if (bi->terminator == TK_UNREACHABLE) {
       // this block ends by a call to a function with noreturn attribute
-      errorBlocks.insert(&*bb);
+      errorBlocks.insert(bb);
       goto classified_block;
     }
-    for(BasicBlock::iterator in = bb->begin(), ine = bb->end(); in != ine; ++in) {
-      CallSite cs(cast<Value>(in));
-      if (cs) {
-        Function *tgt = cs.getCalledFunction();
-        if (knownErrorFunctions->find(tgt) != knownErrorFunctions->end()) {
-          // this block calls into a function that does not return,
-          // but does not have the noreturn attribute
-          errorBlocks.insert(&*bb);
-          goto classified_block;
-        }
+    for(unsigned ci = bi->callsBegin; ci < bi->callsEnd; ci++) {
+      Function *tgt = findex.callSites[ci].target;
+      if (knownErrorFunctions->find(tgt) != knownErrorFunctions->end()) {
+        // this block calls into a function that does not return,
+        // but does not have the noreturn attribute
+        errorBlocks.insert(bb);
+        goto classified_block;
       }
     }
-    if (ReturnInst::classof(bb->getTerminator())) {
+    if (bi->terminator == TK_RETURN) {
       // this block has a return statement
-      if (onlyCheck && entry == &*bb) {
+      if (onlyCheck && entry == bb) {
         return false;
       }
-      returningBlocks.insert(&*bb);
+      returnBlocks.insert(bb);
       goto classified_block;
     }
     
     classified_block: ;
   }
   
-  // now add to returning blocks all blocks that can reach a returning block
+  // now find all blocks that can reach a returning block
   
-  bool addedReturningBlock = !returningBlocks.empty();
-  while(addedReturningBlock) {
-
-    addedReturningBlock = false;
-    for(Function::iterator bb = fun->begin(), bbe = fun->end(); bb != bbe; ++bb) {
-      if (errorBlocks.find(&*bb) == errorBlocks.end() &&
-        returningBlocks.find(&*bb) == returningBlocks.end()) {
-        
-        TerminatorInst *t = bb->getTerminator();
-        for(int i = 0, nsucc = t->getNumSuccessors(); i < nsucc; i++) {
-          BasicBlock *succ = t->getSuccessor(i);
-          if (returningBlocks.find(succ) != returningBlocks.end()) {
-            if (onlyCheck && entry == &*bb) {
-              return false;
-            }          
-            returningBlocks.insert(&*bb);
-            addedReturningBlock = true;
-            break;
-          }
-        }
-      }
+  ReturningBlocksAnalysis analysis(errorBlocks, entry, onlyCheck);
+  DataflowSolver<ReturningBlocksAnalysis> solver(fun, analysis, &errorsStats);
+  
+  for(BasicBlocksSetTy::iterator bi = returnBlocks.begin(), be = returnBlocks.end(); bi != be; ++bi) {
+    solver.seed(*bi, ReturningStateTy(true));
+  }
+  if (!solver.solve()) {
+    return false; // entry block is a returning block
+  }
+  
+  for(Function::iterator bb = fun->begin(), bbe = fun->end(); bb != bbe; ++bb) {
+    if (errorBlocks.find(&*bb) == errorBlocks.end() && solver.isReached(&*bb) && solver.getState(&*bb).returning) {
+      returningBlocks.insert(&*bb);
     }
-  }    
+  }
+  
   // entry block is not a returning block    
   return returningBlocks.find(entry) == returningBlocks.end();
 }
@@ -102,17 +139,31 @@ void findErrorBasicBlocks(Function *fun, FunctionsSetTy *knownErrorFunctions, Ba
 
 // find all functions from module m that do not return, place them into
 // errorFunctions
+//   (the result is remembered in the module index, the detection is run
+//   by several analyses)
 
 void findErrorFunctions(Module *m, FunctionsSetTy& errorFunctions) {
 
+  ModuleIndexTy& index = ModuleIndexTy::get(m);
+  bool cacheable = errorFunctions.empty();
+  if (cacheable && index.getErrorFunctions()) {
+    errorFunctions = *index.getErrorFunctions();
+    return;
+  }
+  if (cacheable && loadCachedFunctions(m, "errorfunctions", errorFunctions)) {
+    index.setErrorFunctions(errorFunctions);
+    return;
+  }
+
+  const std::vector<FunctionIndexTy>& functions = index.getFunctions();
   bool addedErrorFunction = true;
   while(addedErrorFunction) {
     addedErrorFunction = false;
-    for(Module::iterator FI = m->begin(), FE = m->end(); FI != FE; ++FI) {
-      Function *fun = &*FI;
+    for(std::vector<FunctionIndexTy>::const_iterator FI = functions.begin(), FE = functions.end(); FI != FE; ++FI) {
+      Function *fun = FI->fun;
 
       if (!fun) continue;
-      if (!fun->size()) continue;
+      if (FI->blocks.empty()) continue;
     
       if (errorFunctions.find(fun) == errorFunctions.end() && isErrorFunction(fun, &errorFunctions)) {
         errorFunctions.insert(fun);
@@ -120,4 +171,8 @@ void findErrorFunctions(Module *m, FunctionsSetTy& errorFunctions) {
       }
     }
   }
+  if (cacheable) {
+    index.setErrorFunctions(errorFunctions);
+    saveCachedFunctions(m, "errorfunctions", errorFunctions);
+  }
 }
@@ -13,7 +13,9 @@
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
 
+#include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/raw_ostream.h>
 
 #include <unordered_set>
@@ -176,6 +178,28 @@ bool checkTable(Value *v, bool checkDotCallArity, StringMapTy& smap) {
   return true; /* successful parsing */
 }
 
+// reads only the package bitcode, without linking it to the base, functions of interest
+//   are those defined in the package (R_registerRoutines is just a declaration then)
+
+Module *readPackageIR(char *fname, FunctionsOrderedSetTy& functionsOfInterestSet, FunctionsVectorTy& functionsOfInterestVector, LLVMContext& context) {
+
+  SMDiagnostic error;
+  Module *m = parseIRFile(fname, error, context).release();
+  if (!m) {
+    errs() << "ERROR: Cannot read module IR file " << fname << "\n";
+    error.print("fficheck", errs());
+    exit(1);
+  }
+  for(Module::iterator f = m->begin(), fe = m->end(); f != fe; ++f) {
+    Function *fun = &*f;
+    if (!fun->isDeclaration()) {
+      functionsOfInterestSet.insert(fun);
+    }
+  }
+  sortFunctionsByName(functionsOfInterestSet, functionsOfInterestVector);
+  return m;
+}
+
 int main(int argc, char* argv[])
 {
   LLVMContext context;
@@ -183,41 +207,43 @@ int main(int argc, char* argv[])
   FunctionsVectorTy functionsOfInterestVector;
 
   /* fficheck [-i] base.bc packagelib.bc */
+  /* fficheck [-i] -p packagelib.bc */
   
   // most likely the base.bc is not really needed, at least for now
   // -i means read (additional) list of functions to check from the command line
   //   such functions are given using symbol names that are translated using
   //   the registration table to function names where the registration exists
   //   (called with names found in .Call() and .External() calls in R source code)
+  // -p means do not read the base at all, only the package (much faster, the
+  //   checks only need the package code)
 
   // get package name from the last argument
   // there should be a more reliable way..
 
-  if (argc < 2) {
-    errs() << "fficheck [-i] R.bc pkg.so.bc\n";
-    return 2;
-  }
-
   bool readFunList = false;
-  if (!strcmp(argv[1], "-i")) {
-    readFunList = true;
-    char **argvc = (char **) malloc(argc * sizeof(char *));
-    if (!argvc) {
-      errs() << "Out of memory.\n";
-      return 1;
+  bool packageOnly = false;
+  int nopts = 0;
+  
+  for(int i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-i")) {
+      readFunList = true;
+    } else if (!strcmp(argv[i], "-p")) {
+      packageOnly = true;
+    } else {
+      break;
     }
-    argvc[0] = argv[0];
-    int j = 1;
-    for(int i = 2; i < argc; i++)
-      argvc[j++] = argv[i];
-    argvc[j++] = NULL;
-    argc--;
-    argv = argvc;
+    nopts++;
+  }
+  
+  // drop the options, keeping the program name
+  argv[nopts] = argv[0];
+  argv += nopts;
+  argc -= nopts;
 
-    if (argc < 2) {
-      errs() << "fficheck [-i] R.bc pkg.so.bc\n";
-      return 2;
-    }
+  if (argc < 2 || (packageOnly && argc != 2)) {
+    errs() << "fficheck [-i] R.bc pkg.so.bc\n";
+    errs() << "fficheck [-i] -p pkg.so.bc\n";
+    return 2;
   }
   
   char *s = argv[argc-1];
@@ -248,7 +274,12 @@ int main(int argc, char* argv[])
      defines the suffix in R_init_suffix and it is used here only for that purpose.
   */
   
-  Module *m = parseArgsReadIR(argc, argv, functionsOfInterestSet, functionsOfInterestVector, context);
+  Module *m;
+  if (packageOnly) {
+    m = readPackageIR(argv[1], functionsOfInterestSet, functionsOfInterestVector, context);
+  } else {
+    m = parseArgsReadIR(argc, argv, functionsOfInterestSet, functionsOfInterestVector, context);
+  }
  
   std::string initfn = "R_init_";
   initfn.append(pkgname);
@@ -285,7 +316,7 @@ int main(int argc, char* argv[])
   Function* initf = m->getFunction(initfn);
 
   Function *regf = m->getFunction("R_registerRoutines");
-  if (!regf) {
+  if (!regf && !packageOnly) { // in a package alone, it is only declared when called
     errs() << "ERROR: cannot get R_registerRoutines()\n";
     return 1;
   }
@@ -303,7 +334,7 @@ int main(int argc, char* argv[])
         tgt = dyn_cast<Function>(ce->getOperand(0));
       }
     }
-    if (tgt != regf) {
+    if (!tgt || tgt != regf) {
       continue;
     }
       
@@ -348,7 +379,6 @@ int main(int argc, char* argv[])
         break;
     }
     errs() << "Checked additional specified functions: " << checked << "\n";
-    free(argv);
   }
   
   
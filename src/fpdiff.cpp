@@ -0,0 +1,114 @@
+/*
+  Compare results of two runs of a checking tool, by message fingerprints.
+
+  The fingerprints are produced by the tools when environment variable
+  RCHK_FINGERPRINTS is set to a file name (see linemsg.h).
+
+    fpdiff [-a] old_fingerprints new_fingerprints
+
+  prints messages from the new run that are not in the old run (new
+  issues), with -a also messages from the old run that are not in the new
+  run (fixed issues), prefixed by "+ " and "- ", respectively.  Lines are
+  printed in the order of the input files.
+*/
+
+#include <memory>
+#include <string.h>
+#include <unordered_set>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+typedef std::unordered_set<uint64_t> FingerprintsSetTy;
+
+struct FingerprintLineTy {
+  uint64_t fingerprint;
+  StringRef line;
+};
+
+typedef std::vector<FingerprintLineTy> FingerprintLinesTy;
+
+static bool readFingerprints(const char *fname, std::unique_ptr<MemoryBuffer>& buf, FingerprintLinesTy& lines) {
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(fname);
+  if (!res) {
+    errs() << "Cannot read fingerprints file " << fname << ": " << res.getError().message() << "\n";
+    return false;
+  }
+  buf = std::move(res.get());
+
+  StringRef rest = buf->getBuffer();
+  unsigned lineno = 0;
+  while(!rest.empty()) {
+    std::pair<StringRef, StringRef> split = rest.split('\n');
+    StringRef line = split.first;
+    rest = split.second;
+    lineno++;
+
+    if (line.empty()) {
+      continue;
+    }
+    FingerprintLineTy fl;
+    if (line.split('\t').first.getAsInteger(16, fl.fingerprint)) {
+      errs() << "Invalid fingerprint at " << fname << ":" << lineno << "\n";
+      return false;
+    }
+    fl.line = line;
+    lines.push_back(fl);
+  }
+  return true;
+}
+
+static void printMissing(const FingerprintLinesTy& lines, const FingerprintsSetTy& other, const char *prefix) {
+  for(FingerprintLinesTy::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    if (other.find(li->fingerprint) == other.end()) {
+      outs() << prefix << li->line << "\n";
+    }
+  }
+}
+
+static void addFingerprints(const FingerprintLinesTy& lines, FingerprintsSetTy& set) {
+  set.reserve(lines.size());
+  for(FingerprintLinesTy::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    set.insert(li->fingerprint);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  bool all = false;
+  int argi = 1;
+
+  if (argc > 1 && !strcmp(argv[1], "-a")) {
+    all = true;
+    argi++;
+  }
+  if (argc - argi != 2) {
+    errs() << argv[0] << " [-a] old_fingerprints new_fingerprints\n";
+    return 2;
+  }
+
+  std::unique_ptr<MemoryBuffer> oldBuf, newBuf;
+  FingerprintLinesTy oldLines, newLines;
+
+  if (!readFingerprints(argv[argi], oldBuf, oldLines) || !readFingerprints(argv[argi + 1], newBuf, newLines)) {
+    return 2;
+  }
+
+  FingerprintsSetTy oldSet;
+  addFingerprints(oldLines, oldSet);
+  printMissing(newLines, oldSet, all ? "+ " : "");
+
+  if (all) {
+    FingerprintsSetTy newSet;
+    addFingerprints(newLines, newSet);
+    printMissing(oldLines, newSet, "- ");
+  }
+
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include "guards.h"
 #include "exceptions.h"
 #include "patterns.h"
+#include "counters.h"
 
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Constants.h>
@@ -19,6 +20,10 @@ const std::string MSG_PFX = "[UP] ";
 
 using namespace llvm;
 
+static CounterTy callsCounter("freshvars handleCall");
+static CounterTy loadsCounter("freshvars handleLoad");
+static CounterTy storesCounter("freshvars handleStore");
+
 static void pruneFreshVars(Instruction *in, FreshVarsTy& freshVars, LiveVarsTy& liveVars, LineMessenger& msg, unsigned& refinableInfos) {
 
   // clean up freshVars
@@ -53,7 +58,7 @@ static void pruneFreshVars(Instruction *in, FreshVarsTy& freshVars, LiveVarsTy&
 static void unprotectAll(FreshVarsTy& freshVars) {
   freshVars.pstack.clear();
   for (FreshVarsVarsTy::iterator fi = freshVars.vars.begin(), fe = freshVars.vars.end(); fi != fe; ++fi) {
-    fi->second = 0; // zero protect count
+    freshVars.vars.set(fi->first, 0); // zero protect count
   }
 }
 
@@ -155,13 +160,14 @@ static void unprotectOne(FreshVarsTy& freshVars, LineMessenger& msg, unsigned& r
     } else {
       if (msg.debug()) msg.debug(MSG_PFX + "decremented protect count of variable " + varName(var) + " to " + std::to_string(nProtects), in);
     }
-    vsearch->second = nProtects;
+    freshVars.vars.set(var, nProtects);
   }
   if (msg.debug()) msg.debug(MSG_PFX + "unprotected variable " + varName(var), in);
 }
 
 static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *sexpGuardsChecker, SEXPGuardsTy *sexpGuards, FreshVarsTy& freshVars,
     LineMessenger& msg, unsigned& refinableInfos, LiveVarsTy& liveVars, CProtectInfo& cprotect, BalanceStateTy* balance, VarBoolCacheTy& checkedVarsCache) {
+  callsCounter.inc();
   
   bool confused = QUIET_WHEN_CONFUSED && freshVars.confused;
 
@@ -315,7 +321,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
             // typically it was before protected just once, so lets set its protect count to 1
           
             nProtects = 1;
-            vsearch->second = nProtects;
+            freshVars.vars.set(var, nProtects);
             if (msg.debug()) msg.debug(MSG_PFX + "set protect count of variable " + varName(var) + " to 1 at REPROTECT (heuristic)", in);
           }	
         } else {
@@ -350,7 +356,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
         auto vsearch = freshVars.vars.find(var);
         if (vsearch != freshVars.vars.end()) {
           int nProtects = vsearch->second;
-          vsearch->second = ++nProtects;
+          freshVars.vars.set(var, ++nProtects);
           if (msg.debug()) msg.debug(MSG_PFX + "incremented protect count of variable " + varName(var) + " to " + std::to_string(nProtects), in); 
         } else {
           // the variable is not currently fresh, but the fact that it is being protected actually means
@@ -508,6 +514,7 @@ static void handleCall(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *s
 
 static void handleLoad(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker* sexpGuardsChecker, SEXPGuardsTy *sexpGuards, FreshVarsTy& freshVars, LineMessenger& msg,
     unsigned& refinableInfos, LiveVarsTy& liveVars, CProtectInfo& cprotect) {
+  loadsCounter.inc();
     
   if (QUIET_WHEN_CONFUSED && freshVars.confused) {
     return;
@@ -674,6 +681,7 @@ static void unfreshAliasedVars(Instruction *useInst, AllocaInst *useVar, FreshVa
 
 static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *sexpGuardsChecker, SEXPGuardsTy *sexpGuards, 
   FreshVarsTy& freshVars, LineMessenger& msg, unsigned& refinableInfos, BalanceStateTy* balance, VarBoolCacheTy& checkedVarsCache) {
+  storesCounter.inc();
   
   if (QUIET_WHEN_CONFUSED && freshVars.confused) {
     return;
@@ -797,7 +805,7 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
         freshVars.vars.insert({var, nProtects});
         // remember, insert won't overwrite std::map value for an existing key
       } else {
-        vsearch->second = nProtects;
+        freshVars.vars.set(var, nProtects);
       }
       if (msg.debug()) msg.debug(MSG_PFX + "initialized fresh SEXP variable " + varName(var) + " with protect count " + std::to_string(nProtects) +
         " allocated by " + funName(srcFun), in);
@@ -821,7 +829,7 @@ static void handleStore(Instruction *in, CalledModuleTy *cm, SEXPGuardsChecker *
                   freshVars.vars.insert({var, nProtects});
                   // remember, insert won't overwrite std::map value for an existing key
                 } else {
-                  vsearch->second = nProtects;
+                  freshVars.vars.set(var, nProtects);
                 }
                 if (msg.debug()) msg.debug(MSG_PFX + "initialized fresh SEXP variable " + varName(var) + " with protect count " + std::to_string(nProtects) +
                   " based on derived assignment from fresh variable " + varName(dvars), in);
@@ -876,7 +884,7 @@ void StateWithFreshVarsTy::dump(bool verbose) {
   }
   errs() << " protect stack:";
 
-  for(VarsVectorTy::iterator vi = freshVars.pstack.begin(), ve = freshVars.pstack.end(); vi != ve; ++vi) {
+  for(PStackTy::const_iterator vi = freshVars.pstack.begin(), ve = freshVars.pstack.end(); vi != ve; ++vi) {
     AllocaInst* var = *vi;
 
     errs() << " ";
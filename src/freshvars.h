@@ -9,6 +9,7 @@
 #include "liveness.h"
 #include "cprotect.h"
 #include "balance.h"
+#include "zobrist.h"
 
 #include <vector>
 
@@ -19,9 +20,25 @@ using namespace llvm;
 
 const int MAX_PSTACK_SIZE = 64;
 
-typedef std::map<AllocaInst*, int> FreshVarsVarsTy;
+struct FreshVarsEntry_hash {
+  size_t operator()(AllocaInst* var, int pcount) const {
+    size_t res = 0;
+    hash_combine(res, (void *) var);
+    hash_combine(res, pcount);
+    return res;
+  }
+};
+
+struct PStackElem_hash {
+  size_t operator()(AllocaInst* var) const {
+    std::hash<void *> hasher;
+    return hasher(var);
+  }
+};
+
+typedef ZobristMapTy<AllocaInst*, int, FreshVarsEntry_hash> FreshVarsVarsTy; // hashed incrementally
 typedef std::map<AllocaInst*, DelayedLineMessenger> ConditionalMessagesTy;
-typedef std::vector<AllocaInst*> VarsVectorTy;
+typedef ZobristStackTy<AllocaInst*, PStackElem_hash> PStackTy; // hashed incrementally
 
 struct FreshVarsTy {
   FreshVarsVarsTy vars;
@@ -35,7 +52,7 @@ struct FreshVarsTy {
     //   (implicitly protected variables are treated as non-fresh, hence
     //    they are not in this map)
 
-  VarsVectorTy pstack;
+  PStackTy pstack;
     // protection stack
     // contains variables passed to PROTECT
     //   interprets UNPROTECT(const)
@@ -2,15 +2,23 @@
 #include "guards.h"
 #include "patterns.h"
 #include "vectors.h"
+#include "counters.h"
+#include "moduleindex.h"
 
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/InstIterator.h>
 
 #include <llvm/Support/raw_ostream.h>
 
 using namespace llvm;
 
+static CounterTy intGuardCacheHitsCounter("int guard cache hits");
+static CounterTy intGuardCacheMissesCounter("int guard cache misses");
+static CounterTy sexpGuardCacheHitsCounter("sexp guard cache hits");
+static CounterTy sexpGuardCacheMissesCounter("sexp guard cache misses");
+
 // integer guard is a local variable
 //   which is compared at least once against a constant zero, but never compared against anything else
 //   which may be stored to and loaded from
@@ -82,8 +90,10 @@ static bool isIntegerGuardVariable(AllocaInst* var) {
 bool IntGuardsChecker::isGuard(AllocaInst* var) {
   auto csearch = varsCache.find(var);
   if (csearch != varsCache.end()) {
+    intGuardCacheHitsCounter.inc();
     return csearch->second;
   }
+  intGuardCacheMissesCounter.inc();
 
   bool res = isIntegerGuardVariable(var);
   
@@ -263,9 +273,9 @@ PackedIntGuardsTy IntGuardsChecker::pack(const IntGuardsTy& intGuards) {
     unsigned base = varIdx * IGS_BITS;
     
     switch(gs) {
-      case IGS_NONZERO: packed.bits[base] = true; break;     // 1 0
-      case IGS_ZERO:    packed.bits[base + 1] = true; break; // 0 1
-      case IGS_UNKNOWN: break;                               // implied 0 0
+      case IGS_NONZERO: packed.bits.setField(base, IGS_BITS, 1); break; // 1 0 (bits base, base + 1)
+      case IGS_ZERO:    packed.bits.setField(base, IGS_BITS, 2); break; // 0 1
+      case IGS_UNKNOWN: break;                                          // implied 0 0
     }
     // 0 0 means UNKNOWN (or not included)
   }
@@ -276,23 +286,27 @@ PackedIntGuardsTy IntGuardsChecker::pack(const IntGuardsTy& intGuards) {
 IntGuardsTy IntGuardsChecker::unpack(const PackedIntGuardsTy& intGuards) {
 
   IntGuardsTy unpacked;
-  unsigned nvars = intGuards.bits.size() / IGS_BITS;
+  unsigned nbits = intGuards.bits.size();
   
-  myassert(nvars * IGS_BITS == intGuards.bits.size());
+  myassert((nbits / IGS_BITS) * IGS_BITS == nbits);
   
-  for(unsigned varIdx = 0; varIdx < nvars; varIdx++) {
+  // variables with no bits set are UNKNOWN, only visit the others (zero words are skipped)
+  for(unsigned bit = intGuards.bits.findNext(0); bit < nbits; ) {
+    unsigned varIdx = bit / IGS_BITS;
     unsigned base = varIdx * IGS_BITS;
+    unsigned field = intGuards.bits.getField(base, IGS_BITS);
     IntGuardState gs = IGS_UNKNOWN;
     
-    if (intGuards.bits[base]) {
+    if (field & 1) {
       gs = IGS_NONZERO;  
-    } else if (intGuards.bits[base + 1]) {
+    } else if (field & 2) {
       gs = IGS_ZERO;
     }
     
     if (gs != IGS_UNKNOWN) {
       unpacked.insert({varIndex.at(varIdx), gs});
     }
+    bit = intGuards.bits.findNext(base + IGS_BITS);
   }
   return unpacked;
 }
@@ -300,12 +314,7 @@ IntGuardsTy IntGuardsChecker::unpack(const PackedIntGuardsTy& intGuards) {
 void IntGuardsChecker::hash(size_t& res, const IntGuardsTy& intGuards) {
 
   hash_combine(res, intGuards.size());
-  for(IntGuardsTy::const_iterator gi = intGuards.begin(), ge = intGuards.end(); gi != ge; ++gi) {
-    AllocaInst* var = gi->first;
-    IntGuardState s = gi->second;
-    hash_combine(res, (void *)var);
-    hash_combine(res, (size_t) s);
-  } // ordered map
+  hash_combine(res, intGuards.hash()); // maintained incrementally
 }
 
 // SEXP guard is a local variable of type SEXP
@@ -409,8 +418,10 @@ bool SEXPGuardsChecker::uncachedIsGuard(AllocaInst* var) {
 bool SEXPGuardsChecker::isGuard(AllocaInst* var) {
   auto csearch = varsCache.find(var);
   if (csearch != varsCache.end()) {
+    sexpGuardCacheHitsCounter.inc();
     return csearch->second;
   }
+  sexpGuardCacheMissesCounter.inc();
 
   bool res = uncachedIsGuard(var);
   
@@ -418,7 +429,7 @@ bool SEXPGuardsChecker::isGuard(AllocaInst* var) {
   return res;
 }
 
-std::string sgs_name(SEXPGuardTy& g) {
+std::string sgs_name(const SEXPGuardTy& g) {
 
   SEXPGuardState sgs = g.state;
   switch(sgs) {
@@ -1074,12 +1085,12 @@ PackedSEXPGuardsTy SEXPGuardsChecker::pack(const SEXPGuardsTy& sexpGuards) {
     
     unsigned base = idx * SGS_BITS;
     switch(gs) {
-      case SGS_NIL:    packed.bits[base] = true; break;     // 1 0 0
-      case SGS_NONNIL: packed.bits[base + 1] = true; break; // 0 1 0
-      case SGS_SYMBOL: packed.bits[base] = true; packed.bits[base + 1] = true; // 1 1 0
+      case SGS_NIL:    packed.bits.setField(base, SGS_BITS, 1); break; // 1 0 0 (bits base, base + 1, base + 2)
+      case SGS_NONNIL: packed.bits.setField(base, SGS_BITS, 2); break; // 0 1 0
+      case SGS_SYMBOL: packed.bits.setField(base, SGS_BITS, 3);        // 1 1 0
                        packed.symbols.push_back(guard.symbolName);
                        break;
-      case SGS_VECTOR: packed.bits[base + 2] = true; break;     // 0 0 1
+      case SGS_VECTOR: packed.bits.setField(base, SGS_BITS, 4); break; // 0 0 1
       case SGS_UNKNOWN: break; // 0 0 0
     }
   }
@@ -1089,19 +1100,23 @@ PackedSEXPGuardsTy SEXPGuardsChecker::pack(const SEXPGuardsTy& sexpGuards) {
 
 SEXPGuardsTy SEXPGuardsChecker::unpack(const PackedSEXPGuardsTy& sexpGuards) {
   SEXPGuardsTy unpacked;
-  unsigned nvars = sexpGuards.bits.size() / SGS_BITS;
+  unsigned nbits = sexpGuards.bits.size();
   
-  myassert(nvars * SGS_BITS == sexpGuards.bits.size());
+  myassert((nbits / SGS_BITS) * SGS_BITS == nbits);
   unsigned symbolIdx = 0;
   
-  for(unsigned idx = 0; idx < nvars; idx++) {
+  // variables with no bits set are UNKNOWN, only visit the others (zero words are skipped)
+  for(unsigned bit = sexpGuards.bits.findNext(0); bit < nbits; ) {
+    unsigned idx = bit / SGS_BITS;
     unsigned base = idx * SGS_BITS;
     SEXPGuardState gs = SGS_UNKNOWN;
     std::string symbolName;
     
-    bool bit2 = sexpGuards.bits[base];
-    bool bit1 = sexpGuards.bits[base + 1];
-    bool bit0 = sexpGuards.bits[base + 2];
+    unsigned field = sexpGuards.bits.getField(base, SGS_BITS);
+    bool bit2 = field & 1;
+    bool bit1 = field & 2;
+    bool bit0 = field & 4;
+    bit = sexpGuards.bits.findNext(base + SGS_BITS);
     
     if (bit2) {
       if (bit1) {
@@ -1128,13 +1143,7 @@ SEXPGuardsTy SEXPGuardsChecker::unpack(const PackedSEXPGuardsTy& sexpGuards) {
   
 void SEXPGuardsChecker::hash(size_t& res, const SEXPGuardsTy& sexpGuards) {
   hash_combine(res, sexpGuards.size());
-  for(SEXPGuardsTy::const_iterator gi = sexpGuards.begin(), ge = sexpGuards.end(); gi != ge; ++gi) {
-    AllocaInst* var = gi->first;
-    const SEXPGuardTy& g = gi->second;
-    hash_combine(res, (void *) var);
-    hash_combine(res, (size_t) g.state);
-    hash_combine(res, g.symbolName);
-  } // ordered map
+  hash_combine(res, sexpGuards.hash()); // maintained incrementally
 }
 
 // common
@@ -1155,7 +1164,7 @@ void StateWithGuardsTy::dump(bool verbose) {
   errs() << "=== sexp guards: " << &sexpGuards << "\n";
   for(SEXPGuardsTy::iterator gi = sexpGuards.begin(), ge = sexpGuards.end(); gi != ge; ++gi) {
     AllocaInst *i = gi->first;
-    SEXPGuardTy &g = gi->second;
+    const SEXPGuardTy &g = gi->second;
     
     errs() << "   " << varName(i) << " ";
     if (verbose) {
@@ -1164,3 +1173,80 @@ void StateWithGuardsTy::dump(bool verbose) {
     errs() << " state: " << sgs_name(g) << "\n";
   }  
 }
+
+// bits per variable, variable not in the guards is encoded as zero
+
+const unsigned ENC_INT_BITS = 2; // 1 nonzero, 2 zero, 3 unknown
+const unsigned ENC_SEXP_BITS = 3; // 1 nil, 2 non-nil, 3 symbol, 4 vector, 5 unknown
+const unsigned ENC_SYMBOL_BITS = 16; // index of the symbol name of a symbol
+
+void GuardsEncoderTy::reset(Function *f, IntGuardsChecker& intGuardsChecker, SEXPGuardsChecker& sexpGuardsChecker) {
+
+  intVars.clear();
+  sexpVars.clear();
+  symbols.clear();
+  nbits = 0;
+
+  // the set of variables has to be known upfront, bits of a variable added later would not
+  // be constrained in the sets built before
+  const std::vector<AllocaInst*>& vars = ModuleIndexTy::get(f->getParent()).getFunction(f).vars;
+  for(std::vector<AllocaInst*>::const_iterator vi = vars.begin(), ve = vars.end(); vi != ve; ++vi) {
+    AllocaInst *var = *vi;
+    if (intGuardsChecker.isGuard(var)) {
+      intVars.insert({var, nbits});
+      nbits += ENC_INT_BITS;
+    }
+    if (sexpGuardsChecker.isGuard(var)) {
+      sexpVars.insert({var, nbits});
+      nbits += ENC_SEXP_BITS + ENC_SYMBOL_BITS;
+    }
+  }
+
+  // a variable used with a vector-only operation (e.g. LENGTH) is recorded as a vector in the
+  // sexp guards even when it is not a guard (see SEXPGuardsChecker::handleForNonTerminator)
+  for(inst_iterator ii = inst_begin(*f), ie = inst_end(*f); ii != ie; ++ii) {
+    AllocaInst *var;
+    if (isVectorOnlyVarOperation(&*ii, var) && sexpVars.find(var) == sexpVars.end()) {
+      sexpVars.insert({var, nbits});
+      nbits += ENC_SEXP_BITS + ENC_SYMBOL_BITS;
+    }
+  }
+}
+
+PackedBitsTy GuardsEncoderTy::encode(const StateWithGuardsTy& s) {
+
+  PackedBitsTy bits(nbits);
+
+  for(IntGuardsTy::const_iterator gi = s.intGuards.begin(), ge = s.intGuards.end(); gi != ge; ++gi) {
+    auto vsearch = intVars.find(gi->first);
+    myassert(vsearch != intVars.end());
+    unsigned field = 0;
+    switch(gi->second) {
+      case IGS_NONZERO: field = 1; break;
+      case IGS_ZERO:    field = 2; break;
+      case IGS_UNKNOWN: field = 3; break;
+    }
+    bits.setField(vsearch->second, ENC_INT_BITS, field);
+  }
+
+  for(SEXPGuardsTy::const_iterator gi = s.sexpGuards.begin(), ge = s.sexpGuards.end(); gi != ge; ++gi) {
+    auto vsearch = sexpVars.find(gi->first);
+    myassert(vsearch != sexpVars.end());
+    const SEXPGuardTy& g = gi->second;
+    unsigned field = 0;
+    switch(g.state) {
+      case SGS_NIL:     field = 1; break;
+      case SGS_NONNIL:  field = 2; break;
+      case SGS_SYMBOL:  field = 3; break;
+      case SGS_VECTOR:  field = 4; break;
+      case SGS_UNKNOWN: field = 5; break;
+    }
+    bits.setField(vsearch->second, ENC_SEXP_BITS, field);
+    if (g.state == SGS_SYMBOL) {
+      unsigned idx = symbols.insert({g.symbolName, symbols.size() + 1}).first->second;
+      myassert(idx < (1U << ENC_SYMBOL_BITS));
+      bits.setField(vsearch->second + ENC_SEXP_BITS, ENC_SYMBOL_BITS, idx);
+    }
+  }
+  return bits;
+}
@@ -2,19 +2,24 @@
 #define RCHK_GUARDS_H
 
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <llvm/IR/Instructions.h>
 
 using namespace llvm;
 
+#include "zobrist.h"
+
 struct SEXPGuardTy; // there is a cyclic dependency between guards.h and vectors.h
-typedef std::map<AllocaInst*,SEXPGuardTy> SEXPGuardsTy;
+struct SEXPGuardsEntry_hash;
+typedef ZobristMapTy<AllocaInst*,SEXPGuardTy,SEXPGuardsEntry_hash> SEXPGuardsTy;
 class SEXPGuardsChecker;
 
 #include "common.h"
 #include "callocators.h"
 #include "linemsg.h"
+#include "packedbits.h"
 #include "state.h"
 #include "symbols.h"
 #include "table.h"
@@ -29,11 +34,20 @@ enum IntGuardState {
 };
 const unsigned IGS_BITS = 2;
 
-typedef std::map<AllocaInst*,IntGuardState> IntGuardsTy;
+struct IntGuardsEntry_hash {
+  size_t operator()(AllocaInst* var, IntGuardState s) const {
+    size_t res = 0;
+    hash_combine(res, (void *) var);
+    hash_combine(res, (char) s);
+    return res;
+  }
+};
+
+typedef ZobristMapTy<AllocaInst*,IntGuardState,IntGuardsEntry_hash> IntGuardsTy; // hashed incrementally
 
 struct PackedIntGuardsTy {
 
-  typedef std::vector<bool> BitsTy;
+  typedef PackedBitsTy BitsTy;
   BitsTy bits;
   
   PackedIntGuardsTy(unsigned nvars) : bits(nvars * IGS_BITS) {};
@@ -94,11 +108,23 @@ struct SEXPGuardTy {
   
 };
 
+struct SEXPGuardsEntry_hash {
+  size_t operator()(AllocaInst* var, const SEXPGuardTy& g) const {
+    size_t res = 0;
+    hash_combine(res, (void *) var);
+    hash_combine(res, (char) g.state);
+    if (g.state == SGS_SYMBOL) {
+      hash_combine(res, g.symbolName);
+    }
+    return res;
+  }
+};
+
 
 
 struct PackedSEXPGuardsTy {
 
-  typedef std::vector<bool> BitsTy;
+  typedef PackedBitsTy BitsTy;
   BitsTy bits;
   
   typedef std::vector<std::string> SymbolsTy;
@@ -179,4 +205,24 @@ struct PackedStateWithGuardsTy : virtual public PackedStateBaseTy {
     PackedStateBaseTy(bb), intGuards(intGuards), sexpGuards(sexpGuards) {};
 };
 
+// exact encoding of the guards of a state as a bit vector over all guard variables of a function,
+// so that sets of guard valuations can be kept in a BDD (bdd.h)
+//
+// unlike pack(), the encoding distinguishes a variable with unknown value from a variable not
+// in the guards, so that it is equal for exactly the states with equal guards
+
+class GuardsEncoderTy {
+
+  std::unordered_map<AllocaInst*, unsigned> intVars; // guard variable -> its first bit
+  std::unordered_map<AllocaInst*, unsigned> sexpVars;
+  std::unordered_map<std::string, unsigned> symbols; // symbol name -> index (from 1)
+  unsigned nbits;
+
+  public:
+    GuardsEncoderTy(): intVars(), sexpVars(), symbols(), nbits(0) {}
+
+    void reset(Function *f, IntGuardsChecker& intGuardsChecker, SEXPGuardsChecker& sexpGuardsChecker);
+    PackedBitsTy encode(const StateWithGuardsTy& s);
+};
+
 #endif
@@ -1,5 +1,8 @@
 
 #include "lannotate.h"
+#include "lineindex.h"
+
+#include <cstdlib>
 
 #include <llvm/Support/raw_ostream.h>
 
@@ -18,4 +21,9 @@ void printLineAnnotations(LinesTy& lines) {
     const LineTy& l = *li;
     outs() << l.path << " " << std::to_string(l.line) << "\n";
   }
+
+  const char *indexFile = getenv("RCHK_LINE_INDEX");
+  if (indexFile && *indexFile) {
+    writeLineIndex(lines, indexFile);
+  }
 }
@@ -29,6 +29,6 @@ struct LineTy_compare {
 typedef std::set<LineTy, LineTy_compare> LinesTy;
 
 void annotateLine(LinesTy& lines, const Instruction* in);
-void printLineAnnotations(LinesTy& lines);
+void printLineAnnotations(LinesTy& lines); // also writes a line index when RCHK_LINE_INDEX is set (lineindex.h)
 
 #endif
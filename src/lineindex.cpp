@@ -0,0 +1,107 @@
+
+#include "lineindex.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <vector>
+
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+bool writeLineIndex(const LinesTy& lines, const std::string& fileName) {
+
+  // lines are already sorted by path and line
+  std::vector<LineIndexFileTy> files;
+  std::vector<uint32_t> lineNumbers;
+  std::string paths;
+
+  for(LinesTy::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    const LineTy& l = *li;
+    if (files.empty() || l.path.compare(0, std::string::npos, paths, files.back().pathOffset, files.back().pathLength)) {
+      LineIndexFileTy f;
+      f.pathOffset = paths.size();
+      f.pathLength = l.path.size();
+      f.linesBegin = lineNumbers.size();
+      f.linesEnd = lineNumbers.size();
+      files.push_back(f);
+      paths += l.path;
+    }
+    lineNumbers.push_back(l.line);
+    files.back().linesEnd = lineNumbers.size();
+  }
+
+  LineIndexHeaderTy header;
+  header.magic = LINE_INDEX_MAGIC;
+  header.version = LINE_INDEX_VERSION;
+  header.nfiles = files.size();
+  header.nlines = lineNumbers.size();
+  header.pathsSize = paths.size();
+
+  int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    errs() << "Cannot write line index " << fileName << "\n";
+    return false;
+  }
+  raw_fd_ostream out(fd, true);
+  out.write((const char *) &header, sizeof(header));
+  out.write((const char *) files.data(), files.size() * sizeof(LineIndexFileTy));
+  out.write((const char *) lineNumbers.data(), lineNumbers.size() * sizeof(uint32_t));
+  out << paths;
+  return true;
+}
+
+bool LineIndexTy::open(const std::string& fileName) {
+
+  // without the null terminator, the file is mapped rather than read
+#if LLVM_VERSION_MAJOR>=13
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(fileName, false /* IsText */, false /* RequiresNullTerminator */);
+#else
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(fileName, -1, false /* RequiresNullTerminator */);
+#endif
+  if (!res) {
+    errs() << "Cannot read line index " << fileName << ": " << res.getError().message() << "\n";
+    return false;
+  }
+  buf = std::move(res.get());
+
+  const char *start = buf->getBufferStart();
+  size_t size = buf->getBufferSize();
+  header = (const LineIndexHeaderTy *) start;
+
+  if (size < sizeof(LineIndexHeaderTy) || header->magic != LINE_INDEX_MAGIC || header->version != LINE_INDEX_VERSION ||
+      size != sizeof(LineIndexHeaderTy) + (size_t) header->nfiles * sizeof(LineIndexFileTy) + (size_t) header->nlines * sizeof(uint32_t) + header->pathsSize) {
+    errs() << "Invalid line index " << fileName << "\n";
+    buf.reset();
+    header = NULL;
+    return false;
+  }
+
+  files = (const LineIndexFileTy *) (start + sizeof(LineIndexHeaderTy));
+  lines = (const uint32_t *) (files + header->nfiles);
+  paths = (const char *) (lines + header->nlines);
+
+  for(unsigned i = 0; i < header->nfiles; i++) {
+    const LineIndexFileTy& f = files[i];
+    if ((uint64_t) f.pathOffset + f.pathLength > header->pathsSize || f.linesBegin > f.linesEnd || f.linesEnd > header->nlines) {
+      errs() << "Invalid line index " << fileName << "\n";
+      buf.reset();
+      header = NULL;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LineIndexTy::contains(StringRef path, unsigned line) const {
+
+  const LineIndexFileTy* filesEnd = files + header->nfiles;
+  const LineIndexFileTy* f = std::lower_bound(files, filesEnd, path, [this](const LineIndexFileTy& f, StringRef path) {
+    return filePath(f) < path;
+  });
+  if (f == filesEnd || filePath(*f) != path) {
+    return false;
+  }
+  return std::binary_search(lines + f->linesBegin, lines + f->linesEnd, (uint32_t) line);
+}
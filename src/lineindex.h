@@ -0,0 +1,66 @@
+#ifndef RCHK_LINEINDEX_H
+#define RCHK_LINEINDEX_H
+
+#include "lannotate.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+using namespace llvm;
+
+// compact index of annotated source lines (e.g. lines that may call into the GC, from sfpcheck and
+// csfpcheck), written when environment variable RCHK_LINE_INDEX is set to a file name
+//
+// the file is used mapped into memory as it is, a query finds the file and then the line by
+// binary search (see lquery)
+//
+// layout (32-bit unsigned integers in native byte order):
+//
+//   header   magic, version, number of files, number of lines, size of paths
+//   files    for each file (sorted by path): offset and length of path, index of first line and after the last line
+//   lines    line numbers, sorted for each file
+//   paths    path strings (not terminated)
+
+struct LineIndexHeaderTy {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nfiles;
+  uint32_t nlines;
+  uint32_t pathsSize;
+};
+
+struct LineIndexFileTy {
+  uint32_t pathOffset;
+  uint32_t pathLength;
+  uint32_t linesBegin;
+  uint32_t linesEnd;
+};
+
+const uint32_t LINE_INDEX_MAGIC = 0x584c4352; // "RCLX"
+const uint32_t LINE_INDEX_VERSION = 1;
+
+bool writeLineIndex(const LinesTy& lines, const std::string& fileName);
+
+class LineIndexTy {
+  std::unique_ptr<MemoryBuffer> buf;
+  const LineIndexHeaderTy* header;
+  const LineIndexFileTy* files;
+  const uint32_t* lines;
+  const char* paths;
+
+  StringRef filePath(const LineIndexFileTy& f) const { return StringRef(paths + f.pathOffset, f.pathLength); }
+
+  public:
+    LineIndexTy(): buf(), header(NULL), files(NULL), lines(NULL), paths(NULL) {}
+
+    bool open(const std::string& fileName); // false (and a message) when the file cannot be read or is invalid
+    bool contains(StringRef path, unsigned line) const;
+    unsigned getNumberOfFiles() const { return header->nfiles; }
+    unsigned getNumberOfLines() const { return header->nlines; }
+};
+
+#endif
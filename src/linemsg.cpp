@@ -1,8 +1,88 @@
 
 #include "linemsg.h"
+#include "shard.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/Support/Format.h>
 
 using namespace llvm;
 
+struct MsgStringTableTy {
+  std::unordered_map<std::string, MsgStringIdTy> ids;
+  std::vector<const std::string*> strings; // keys of ids, indexed by id
+};
+
+static MsgStringTableTy& msgStringTable() {
+  static MsgStringTableTy table;
+  return table;
+}
+
+MsgStringIdTy internMsgString(const std::string& str) {
+  MsgStringTableTy& table = msgStringTable();
+  auto sinsert = table.ids.insert({str, (MsgStringIdTy) table.strings.size()});
+  if (sinsert.second) {
+    table.strings.push_back(&sinsert.first->first);
+  }
+  return sinsert.first->second;
+}
+
+const std::string& msgString(MsgStringIdTy id) {
+  return *msgStringTable().strings.at(id);
+}
+
+static const MsgStringIdTy KIND_NONE = internMsgString("");
+static const MsgStringIdTy KIND_TRACE = internMsgString("TRACE");
+static const MsgStringIdTy KIND_DEBUG = internMsgString("DEBUG");
+static const MsgStringIdTy KIND_INFO = internMsgString("INFO");
+static const MsgStringIdTy KIND_ERROR = internMsgString("ERROR");
+
+static const MsgStringIdTy PATH_NONE = KIND_NONE;
+static const MsgStringIdTy PATH_UNKNOWN = internMsgString("/unknown");
+
+// the same as sourceLocation(in, path, line), but without building the path string
+//   for every message: paths are cached per scope (scopes live as long as the module,
+//   and the tools only read one)
+//
+// the cache is not synchronized, messengers are only used from a single thread (the
+// parallel checkers write to per-function output buffers instead)
+
+typedef DenseMap<const DIScope*, MsgStringIdTy> ScopePathsTy;
+
+static bool sourceLocationId(const Instruction *in, MsgStringIdTy& path, unsigned& line) {
+  if (!in) {
+    return false;
+  }
+  const DebugLoc& debugLoc = in->getDebugLoc();
+  
+  if (!debugLoc) {
+    path = PATH_UNKNOWN;
+    line = 0;
+    return false;
+  }
+
+  line = debugLoc.getLine();  
+  if (DIScope *scope = dyn_cast<DIScope>(debugLoc.getScope())) {
+    static ScopePathsTy scopePaths;
+  
+    auto ssearch = scopePaths.find(scope);
+    if (ssearch != scopePaths.end()) {
+      path = ssearch->second;
+      return true;
+    }
+    path = internMsgString(scopePath(scope));
+    scopePaths.insert({scope, path});
+  }
+  return true;
+}
+
 std::string BaseLineMessenger::withTrace(const std::string& msg, Instruction *in) const {
   if (TRACE) {
     return msg + instructionAsString(in);
@@ -12,35 +92,39 @@ std::string BaseLineMessenger::withTrace(const std::string& msg, Instruction *in
 
 void BaseLineMessenger::trace(const std::string& msg, Instruction *in) {
   if (TRACE) {
-    emit("TRACE", withTrace(msg, in), in);
+    emit(KIND_TRACE, withTrace(msg, in), in);
   }
 }
 
 void BaseLineMessenger::debug(const std::string& msg, Instruction *in) {
   if (_DEBUG) {
-    emit("DEBUG", withTrace(msg, in), in);
+    emit(KIND_DEBUG, withTrace(msg, in), in);
   }
 }
 
 void BaseLineMessenger::info(const std::string& msg, Instruction *in) {
-  emit(_DEBUG ? "INFO" : "", withTrace(msg, in), in);
+  emit(_DEBUG ? KIND_INFO : KIND_NONE, withTrace(msg, in), in);
 }
 
 void BaseLineMessenger::error(const std::string& msg, Instruction *in) {
-  emit("ERROR", withTrace(msg, in), in);
+  emit(KIND_ERROR, withTrace(msg, in), in);
 }
 
 void BaseLineMessenger::emit(const std::string& kind, const std::string& message, Instruction *in) {
-  if (kind == "DEBUG" && !_DEBUG) {
+  emit(internMsgString(kind), message, in);
+}
+
+void BaseLineMessenger::emit(MsgStringIdTy kind, const std::string& message, Instruction *in) {
+  if (kind == KIND_DEBUG && !_DEBUG) {
     return;
   }
-  if (kind == "TRACE" && !TRACE) {
+  if (kind == KIND_TRACE && !TRACE) {
     return;
   }
 
-  std::string path;
-  unsigned line;
-  sourceLocation(in, path, line);
+  MsgStringIdTy path = PATH_NONE;
+  unsigned line = 0;
+  sourceLocationId(in, path, line);
   LineInfoTy li(kind, message, path, line);
   emit(&li);
 }
@@ -50,19 +134,32 @@ void BaseLineMessenger::emit(const std::string& kind, const std::string& message
 
 void LineInfoTy::print() const {
   outs() << "  ";
-  if (!kind.empty()) {
-    outs()  << kind << ": ";
+  if (kind != KIND_NONE) {
+    outs()  << msgString(kind) << ": ";
   }
-  if (path.empty()) {
+  const std::string& pathStr = msgString(path);
+  if (pathStr.empty()) {
     outs() << message << "\n";
   } else {
-    outs() << message << " " << path << ":" << line << "\n";
+    outs() << message << " " << pathStr << ":" << line << "\n";
+  }
+}
+
+// the order of strings is alphabetical (for printing), but most comparisons
+//   are of equal (interned) strings, which need not be looked up
+static int compareMsgStrings(MsgStringIdTy lhs, MsgStringIdTy rhs) {
+  if (lhs == rhs) {
+    return 0;
   }
+  return msgString(lhs).compare(msgString(rhs));
 }
 
 bool LineInfoTyPtr_compare::operator() (const LineInfoTy* lhs, const LineInfoTy* rhs) const {
+  if (lhs == rhs) {
+    return false;
+  }
   int cmp;
-  cmp = lhs->path.compare(rhs->path);
+  cmp = compareMsgStrings(lhs->path, rhs->path);
   if (cmp) {
     return cmp < 0;
   }
@@ -73,27 +170,226 @@ bool LineInfoTyPtr_compare::operator() (const LineInfoTy* lhs, const LineInfoTy*
   if (cmp) {
     return cmp < 0;
   }
-  cmp = lhs->kind.compare(rhs->kind);
+  cmp = compareMsgStrings(lhs->kind, rhs->kind);
   return cmp < 0;
 }
 
 size_t LineInfoTy_hash::operator()(const LineInfoTy& t) const {
-  return t.line;
+  size_t res = 0;
+  hash_combine(res, t.kind);
+  hash_combine(res, t.message);
+  hash_combine(res, t.path);
+  hash_combine(res, t.line);
+  return res;
 }
 
 bool LineInfoTy_equal::operator() (const LineInfoTy& lhs, const LineInfoTy& rhs) const {
-  return lhs.line == rhs.line && lhs.message == rhs.message && lhs.path == rhs.path && lhs.kind == rhs.kind;
+  return lhs == rhs;
 }
 
 // ----------------------------- 
 
+static bool isNameChar(char c) {
+  return isalnum((unsigned char) c) || c == '_';
+}
+
+std::string messageTemplate(const std::string& message) {
+  std::string res;
+  size_t len = message.size();
+  
+  for(size_t i = 0; i < len;) {
+    char c = message[i];
+    
+    if (c == '.' && i > 0 && isNameChar(message[i - 1]) && i + 1 < len && isdigit((unsigned char) message[i + 1])) {
+      // numeric suffix of a name (e.g. x.12, foo.constprop.0)
+      size_t j = i + 1;
+      while(j < len && isdigit((unsigned char) message[j])) j++;
+      if (j == len || !isNameChar(message[j])) {
+        i = j;
+        continue;
+      }
+    }
+    if (isdigit((unsigned char) c) && !(i > 0 && isNameChar(message[i - 1]))) {
+      // a number (not part of a name)
+      while(i < len && isNameChar(message[i])) i++;
+      res += '#';
+      continue;
+    }
+    res += c;
+    i++;
+  }
+  return res;
+}
+
+// FNV-1a, as the fingerprints have to be the same in different runs and builds
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t fnvHash(uint64_t h, const std::string& str) {
+  for(std::string::const_iterator ci = str.begin(), ce = str.end(); ci != ce; ++ci) {
+    h ^= (unsigned char) *ci;
+    h *= FNV_PRIME;
+  }
+  h ^= 0xff; // separator
+  h *= FNV_PRIME;
+  return h;
+}
+
+static uint64_t fnvHash(uint64_t h, uint64_t value) {
+  for(unsigned i = 0; i < 8; i++) {
+    h ^= (value >> (8 * i)) & 0xff;
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+static raw_ostream* fingerprintStream() {
+  static std::unique_ptr<raw_fd_ostream> stream;
+  static bool initialized = false;
+  
+  if (!initialized) {
+    initialized = true;
+    const char *fname = getenv("RCHK_FINGERPRINTS");
+    if (fname && *fname) {
+      int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fd < 0) {
+        errs() << "Cannot open fingerprints file " << fname << "\n";
+      } else {
+        stream.reset(new raw_fd_ostream(fd, true));
+      }
+    }
+  }
+  return stream.get();
+}
+
+void LineMessenger::printFingerprint(const LineInfoTy* li) {
+  raw_ostream *out = fingerprintStream();
+  if (!out || !lastFunction) {
+    return;
+  }
+  
+  uint64_t th = fnvHash(FNV_OFFSET, messageTemplate(li->message));
+  std::string fname = funName(lastFunction) + lastChecksName;
+  uint64_t key = fnvHash(fnvHash(th, fname), msgString(li->kind));
+  unsigned idx = fingerprintCounts[key]++;
+  uint64_t fp = fnvHash(key, (uint64_t) idx);
+  
+  *out << format_hex_no_prefix(fp, 16) << "\t" << fname << "\t" << msgString(li->kind) << "\t" << li->message
+    << "\t" << msgString(li->path) << ":" << li->line << "\n";
+}
+
+static raw_ostream* reportStream() {
+  static std::unique_ptr<raw_fd_ostream> stream;
+  static bool initialized = false;
+  
+  if (!initialized) {
+    initialized = true;
+    const char *fname = getenv("RCHK_REPORT");
+    if (fname && *fname) {
+      int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fd < 0) {
+        errs() << "Cannot open report file " << fname << "\n";
+      } else {
+        stream.reset(new raw_fd_ostream(fd, true));
+      }
+    }
+  }
+  return stream.get();
+}
+
+static void printJSONString(raw_ostream& out, const std::string& str) {
+  out << '"';
+  for(std::string::const_iterator ci = str.begin(), ce = str.end(); ci != ce; ++ci) {
+    unsigned char c = *ci;
+    if (c == '"' || c == '\\') {
+      out << '\\' << (char) c;
+    } else if (c < 0x20) {
+      out << "\\u" << format_hex_no_prefix(c, 4);
+    } else {
+      out << (char) c;
+    }
+  }
+  out << '"';
+}
+
+void LineMessenger::startReport(unsigned nfunctions) {
+  raw_ostream *out = reportStream();
+  if (!out) {
+    return;
+  }
+  report = true;
+  *out << "{\"event\":\"start\",\"functions\":" << nfunctions << "}\n";
+  out->flush();
+}
+
+void LineMessenger::endReport() {
+  if (!report) {
+    return;
+  }
+  raw_ostream *out = reportStream();
+  *out << "{\"event\":\"end\",\"functions\":" << reportedFunctions << "}\n";
+  out->flush();
+}
+
+void LineMessenger::printReport() {
+  raw_ostream *out = reportStream();
+
+  *out << "{\"event\":\"function\",\"index\":" << reportedFunctions++ << ",\"function\":";
+  printJSONString(*out, funName(lastFunction));
+  *out << ",\"checks\":";
+  printJSONString(*out, lastChecksName);
+  *out << ",\"messages\":[";
+
+  bool first = true;
+  auto printLine = [&](const LineInfoTy* li) {
+    if (!first) {
+      *out << ",";
+    }
+    first = false;
+    *out << "{\"kind\":";
+    printJSONString(*out, msgString(li->kind));
+    *out << ",\"message\":";
+    printJSONString(*out, li->message);
+    *out << ",\"path\":";
+    printJSONString(*out, msgString(li->path));
+    *out << ",\"line\":" << li->line << "}";
+  };
+  for(LineInfoPtrSetTy::const_iterator li = lineBuffer.begin(), le = lineBuffer.end(); li != le; ++li) {
+    printLine(*li);
+  }
+  for(std::vector<const LineInfoTy*>::const_iterator li = reportLines.begin(), le = reportLines.end(); li != le; ++li) {
+    printLine(*li);
+  }
+  *out << "]}\n";
+  out->flush();
+  outs().flush();
+}
+
+void LineMessenger::functionDone() {
+  if (report) {
+    printReport();
+  }
+  if (linesHandler) {
+    std::vector<const LineInfoTy*> lines(lineBuffer.begin(), lineBuffer.end());
+    lines.insert(lines.end(), reportLines.begin(), reportLines.end());
+    linesHandler(lastFunction, lastChecksName, lines);
+  }
+  reportLines.clear();
+}
+
 void LineMessenger::flush() {
-  if (lastFunction != NULL && !lineBuffer.empty()) {
-    outs() << "\nFunction " << funName(lastFunction) << lastChecksName << "\n";
-    for(LineInfoPtrSetTy::const_iterator liBuf = lineBuffer.begin(), liEbuf = lineBuffer.end(); liBuf != liEbuf; ++liBuf) {
-      const LineInfoTy* li = *liBuf;
-      li->print();
+  if (lastFunction != NULL) {
+    if (!lineBuffer.empty()) {
+      printShardMarker(outs(), lastFunction);
+      outs() << "\nFunction " << funName(lastFunction) << lastChecksName << "\n";
+      for(LineInfoPtrSetTy::const_iterator liBuf = lineBuffer.begin(), liEbuf = lineBuffer.end(); liBuf != liEbuf; ++liBuf) {
+        const LineInfoTy* li = *liBuf;
+        li->print();
+        printFingerprint(li);
+      }
     }
+    functionDone();
     lineBuffer.clear();
   }
   internTable.clear();
@@ -102,10 +398,15 @@ void LineMessenger::flush() {
 
 void LineMessenger::newFunction(Function *func, const std::string& checksName) {
   if (!UNIQUE_MSG) {
+    if (lastFunction) {
+      functionDone();
+    }
+    printShardMarker(outs(), func);
     outs() << "\nFunction " << funName(func) << checksName << "\n";
   } else {
     flush();
   }
+  fingerprintCounts.clear();
   lastChecksName = checksName;
   lastFunction = func;
 }
@@ -113,6 +414,10 @@ void LineMessenger::newFunction(Function *func, const std::string& checksName) {
 void LineMessenger::emitInterned(const LineInfoTy* li) {
   if (!UNIQUE_MSG) {
     li->print();
+    printFingerprint(li);
+    if (report || linesHandler) {
+      reportLines.push_back(li);
+    }
   } else {
     lineBuffer.insert(li);
   }
@@ -133,6 +438,8 @@ void LineMessenger::clear() {
     lineBuffer.clear();
     // not clearing the intern table
   }
+  reportLines.clear();
+  fingerprintCounts.clear();
 }
 
 // ----------------------------- 
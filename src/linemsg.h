@@ -5,7 +5,11 @@
 
 #include "table.h"
 
+#include <functional>
 #include <set>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
 
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instruction.h>
@@ -16,15 +20,29 @@
 
 using namespace llvm;
 
+// message kinds and paths are interned into small ids, so that they are compared
+// and hashed as integers; there are only a few of them (the paths are of source
+// files), so the table lives as long as the process and is not synchronized
+// (messengers are only used from a single thread)
+//
+// message texts are not interned, they differ in every state and would never be freed
+
+typedef unsigned MsgStringIdTy;
+
+MsgStringIdTy internMsgString(const std::string& str);
+const std::string& msgString(MsgStringIdTy id);
+
 struct LineInfoTy {
-  const std::string kind;
+  const MsgStringIdTy kind;
   const std::string message;
-  const std::string path;
+  const MsgStringIdTy path;
   const unsigned line;
   
   public:
-    LineInfoTy(const std::string& kind, const std::string& message, const std::string& path, unsigned line): 
+    LineInfoTy(MsgStringIdTy kind, const std::string& message, MsgStringIdTy path, unsigned line): 
       kind(kind), message(message), path(path), line(line) {}
+    LineInfoTy(const std::string& kind, const std::string& message, const std::string& path, unsigned line): 
+      kind(internMsgString(kind)), message(message), path(internMsgString(path)), line(line) {}
     
     void print() const;
     bool operator==(const LineInfoTy& other) const {
@@ -47,6 +65,9 @@ struct LineInfoTy_equal {
 typedef std::set<const LineInfoTy*, LineInfoTyPtr_compare> LineInfoPtrSetTy; // for ordering messages, uniqueness
 typedef InterningTable<LineInfoTy, LineInfoTy_hash, LineInfoTy_equal> LineInfoTableTy; // for interning table (performance)
 
+// receives the messages of a function (and checks name) once they have all been printed (e.g. to keep them in a checkpoint)
+typedef std::function<void(Function*, const std::string&, const std::vector<const LineInfoTy*>&)> FunctionLinesHandlerTy;
+
 class BaseLineMessenger {
 
   protected:
@@ -71,6 +92,7 @@ class BaseLineMessenger {
     bool uniqueMsg() const { return UNIQUE_MSG; }
     
     void emit(const std::string& kind, const std::string& message, Instruction *in);
+    void emit(MsgStringIdTy kind, const std::string& message, Instruction *in);
     virtual void emit(const LineInfoTy* li) = 0;
     virtual ~BaseLineMessenger() = default;
 };
@@ -86,10 +108,22 @@ class LineMessenger : public BaseLineMessenger {
   Function *lastFunction;
   std::string lastChecksName;
 //  const LLVMContext& context;
+
+  std::unordered_map<uint64_t, unsigned> fingerprintCounts; // occurrences of message templates in the current function
+  void printFingerprint(const LineInfoTy* li);
+
+  bool report; // streaming machine-readable report enabled
+  unsigned reportedFunctions;
+  std::vector<const LineInfoTy*> reportLines; // messages of the current function, when not buffered in lineBuffer (for the report or lines handler)
+  void printReport();
+
+  FunctionLinesHandlerTy linesHandler;
+  void functionDone(); // reports the messages of the last function
   
   public:
     LineMessenger(LLVMContext& context, bool _DEBUG, bool TRACE, bool UNIQUE_MSG):
-      BaseLineMessenger(_DEBUG, TRACE, UNIQUE_MSG), lineBuffer(), internTable(), lastFunction(NULL), lastChecksName() {};
+      BaseLineMessenger(_DEBUG, TRACE, UNIQUE_MSG), lineBuffer(), internTable(), lastFunction(NULL), lastChecksName(), fingerprintCounts(),
+      report(false), reportedFunctions(0), reportLines(), linesHandler() {};
 //      BaseLineMessenger(_DEBUG, TRACE, UNIQUE_MSG), lineBuffer(), internTable(), lastFunction(NULL), lastChecksName(), context(context)  {};
       
     void flush();
@@ -101,8 +135,39 @@ class LineMessenger : public BaseLineMessenger {
     void emitInterned(const LineInfoTy* li); // emit line info interned in internTable
     
     virtual void emit(const LineInfoTy* li);
+
+    void startReport(unsigned nfunctions); // enables the report if requested, nfunctions is the number of functions to check
+    void endReport();
+    void setLinesHandler(const FunctionLinesHandlerTy& handler) { linesHandler = handler; }
 };
 
+// streaming report
+//
+// when environment variable RCHK_REPORT is set to a file name, the report for each checked function
+// is written to that file as soon as the function is done (also when there are no messages), as a
+// JSON object on a single line
+//
+//   {"event":"start","functions":N}
+//   {"event":"function","index":I,"function":"...","checks":"...","messages":[{"kind":"...","message":"...","path":"...","line":L},...]}
+//   {"event":"end","functions":I}
+//
+// the file is flushed after every line (and so is the standard output), so that progress and partial
+// results can be watched while the tool runs
+
+// stable message fingerprints
+//
+// when environment variable RCHK_FINGERPRINTS is set to a file name, every printed message is also
+// written to that file as a line
+//
+//   fingerprint <TAB> function <TAB> kind <TAB> message <TAB> path:line
+//
+// the fingerprint is a hash of the function (and checks) name, message kind, message template (the message
+// with numbers and numeric suffixes of LLVM names removed), and the index of the message among messages with
+// the same template in the function (in source line order); it does not depend on line numbers, so it survives
+// unrelated changes to the sources and can be used to compare results of two runs (see fpdiff)
+
+std::string messageTemplate(const std::string& message);
+
 // this is a rather special object for conditional/delayed messaging
 //   it remembers messages, preparing them for being printed via LineMessenger msg,
 //   but only prints them if/when flush() is called
@@ -1,6 +1,7 @@
 
 #include "liveness.h"
 #include "table.h"
+#include "dataflow.h"
 
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/CFG.h>
@@ -23,43 +24,65 @@ static VarIndexTy indexVariables(Function *f) {
   
   return varIndex;
 }
-typedef std::vector<bool> VarMapTy;
-
-struct BlockStateTy {
-  VarMapTy usedAfter;
-  VarMapTy killedAfter;
+struct LivenessStateTy {
+  BitSet used; // possibly used after
+  BitSet killed; // possibly killed after
   
-  BlockStateTy(VarMapTy usedAfter, VarMapTy killedAfter): usedAfter(usedAfter), killedAfter(killedAfter) {};
+  LivenessStateTy(): used(), killed() {};
+  LivenessStateTy(unsigned nvars): used(nvars, false), killed(nvars, true) {};
 };
 
-typedef std::unordered_map<BasicBlock*, BlockStateTy> BlockStatesTy;
-typedef std::unordered_set<BasicBlock*> BlockSetTy;
-
-static void applyInstruction(Instruction *in, VarMapTy& used, VarMapTy& killed, VarIndexTy& varIndex) {
+static void applyInstruction(Instruction *in, LivenessStateTy& s, VarIndexTy& varIndex) {
 
   if (StoreInst* si = dyn_cast<StoreInst>(in)) {
     if (AllocaInst* var = dyn_cast<AllocaInst>(si->getPointerOperand())) { // variable is killed
       unsigned vi = varIndex.indexOf(var);
-      used[vi] = false;
-      killed[vi] = true;
+      s.used.reset(vi);
+      s.killed.set(vi);
     }
   }
   if (LoadInst* li = dyn_cast<LoadInst>(in)) {
     if (AllocaInst* var = dyn_cast<AllocaInst>(li->getPointerOperand())) { // variable is used
       unsigned vi = varIndex.indexOf(var);
-      used[vi] = true;
-      killed[vi] = false;
+      s.used.set(vi);
+      s.killed.reset(vi);
     }
   }
 }
 
+struct LivenessAnalysis {
+  typedef LivenessStateTy StateTy;
+  static const DataflowDirection direction = DF_BACKWARD;
+  
+  VarIndexTy& varIndex;
+  
+  LivenessAnalysis(VarIndexTy& varIndex): varIndex(varIndex) {};
+  
+  // compute variables live at block start
+  bool transfer(BasicBlock *bb, StateTy& s) {
+    for(BasicBlock::reverse_iterator ii = bb->rbegin(), ie = bb->rend();  ii != ie; ++ii) {
+      applyInstruction(&*ii, s, varIndex);
+    }
+    return true;
+  }
+  
+  // union of used variables, union of killed variables
+  bool join(StateTy& dst, StateTy& src) {
+    bool changed = dst.used.unionWith(src.used);
+    changed |= dst.killed.unionWith(src.killed);
+    return changed;
+  }
+};
+
+static DataflowStatsTy livenessStats("liveness");
+
 LiveVarsTy findLiveVariables(Function *f) {
 
   VarIndexTy varIndex = indexVariables(f);
   size_t nvars = varIndex.size();
   
-  BlockStatesTy blockStates;
-  BlockSetTy changed;
+  LivenessAnalysis analysis(varIndex);
+  DataflowSolver<LivenessAnalysis> solver(f, analysis, &livenessStats);
   
   // add basic blocks with return statement
   for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
@@ -67,71 +90,23 @@ LiveVarsTy findLiveVariables(Function *f) {
     
     // note: ignoring "error blocks" (unreachable terminators)
     if (ReturnInst::classof(bb->getTerminator())) {
-      VarMapTy usedAfter = VarMapTy(nvars, false);
-      VarMapTy killedAfter = VarMapTy(nvars, true);
-      blockStates.insert({bb, BlockStateTy(usedAfter, killedAfter)});
-      changed.insert(bb);
+      solver.seed(bb, LivenessStateTy(nvars));
     }
   }
   
   // find variables possibly used/killed after each block
-  while(!changed.empty()) {
-    BlockSetTy::iterator bi = changed.begin();
-    BasicBlock* bb = *bi;
-    changed.erase(bi);
-    
-    auto bsearch = blockStates.find(bb);
-    myassert(bsearch != blockStates.end());
-    BlockStateTy& s = bsearch->second;
-    
-    VarMapTy used = s.usedAfter; // copy
-    VarMapTy killed = s.killedAfter; // copy
-    
-    // compute variables live at block start
-    for(BasicBlock::reverse_iterator ii = bb->rbegin(), ie = bb->rend();  ii != ie; ++ii) {
-      Instruction *in = &*ii;
-      applyInstruction(in, used, killed, varIndex);     
-    }
-    
-    // merge into block predecessors
-    for(pred_iterator pi = pred_begin(bb), pe = pred_end(bb); pi != pe; ++pi) {
-      BasicBlock* pb = *pi;
-
-      auto bsearch = blockStates.find(pb);
-      if (bsearch == blockStates.end()) {
-        blockStates.insert({pb, BlockStateTy(used, killed)});
-        changed.insert(pb);
-      } else {
-        BlockStateTy& ps = bsearch->second;
-        VarMapTy& prevUsed = ps.usedAfter;
-        VarMapTy& prevKilled = ps.killedAfter;
-        
-        for(unsigned vi = 0; vi < nvars; vi++) {
-          bool change = false;
-          if (used[vi] && !prevUsed[vi]) { // union of used variables
-            prevUsed[vi] = true;
-            change = true;
-          }
-          if (killed[vi] && !prevKilled[vi]) { // union of killed variables
-            prevKilled[vi] = true;
-            change = true;
-          }          
-          if (change) {
-            changed.insert(pb);
-          }
-        }
-      }
-    }
-  }
+  solver.solve();
   
   // convert results, and compute for each instruction
   LiveVarsTy live;
   
-  for(BlockStatesTy::iterator si = blockStates.begin(), se = blockStates.end(); si != se; ++si) {
-    BasicBlock* bb = si->first;
-    BlockStateTy& s = si->second;
-    VarMapTy used = s.usedAfter;
-    VarMapTy killed = s.killedAfter;
+  const BlockNumbering& blocks = solver.getBlocks();
+  for(unsigned bi = 0, be = blocks.size(); bi != be; bi++) {
+    BasicBlock* bb = blocks.at(bi);
+    if (!solver.isReached(bb)) {
+      continue;
+    }
+    LivenessStateTy s = solver.getState(bb); // copy
     
     for(BasicBlock::reverse_iterator ii = bb->rbegin(), ie = bb->rend();  ii != ie; ++ii) {
       Instruction *in = &*ii;
@@ -141,16 +116,16 @@ LiveVarsTy findLiveVariables(Function *f) {
       
       VarsLiveness vars;
       for(unsigned vi = 0; vi < nvars; vi++) {
-        if (used[vi]) {
+        if (s.used.get(vi)) {
           vars.possiblyUsed.insert(varIndex.at(vi));
         }
-        if (killed[vi]) {
+        if (s.killed.get(vi)) {
           vars.possiblyKilled.insert(varIndex.at(vi));
         }
       }
       live.insert({in, vars});
       
-      applyInstruction(in, used, killed, varIndex);
+      applyInstruction(in, s, varIndex);
     }
   }
   return live;
@@ -0,0 +1,77 @@
+/*
+  Query an index of annotated source lines, e.g. lines that may call into
+  the GC.  The index is written by sfpcheck and csfpcheck when environment
+  variable RCHK_LINE_INDEX is set to a file name (see lineindex.h).
+
+    lquery index path line
+
+  prints "yes" and exits with 0 when the line is in the index, prints "no"
+  and exits with 1 otherwise.
+
+    lquery index
+
+  reads queries "path line" from standard input, one per line, and for each
+  prints the query followed by " yes" or " no".  The index is only mapped
+  once, so this is meant for editors and other long-running clients.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "lineindex.h"
+
+using namespace llvm;
+
+static bool parseQuery(StringRef query, StringRef& path, unsigned& line) {
+  std::pair<StringRef, StringRef> split = query.rsplit(' ');
+  path = split.first;
+  return !path.empty() && !split.second.getAsInteger(10, line);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc != 2 && argc != 4) {
+    errs() << argv[0] << " index [path line]\n";
+    return 2;
+  }
+
+  LineIndexTy index;
+  if (!index.open(argv[1])) {
+    return 2;
+  }
+
+  if (argc == 4) {
+    unsigned line;
+    if (StringRef(argv[3]).getAsInteger(10, line)) {
+      errs() << "Invalid line number " << argv[3] << "\n";
+      return 2;
+    }
+    bool found = index.contains(argv[2], line);
+    outs() << (found ? "yes" : "no") << "\n";
+    return found ? 0 : 1;
+  }
+
+  char *buf = NULL;
+  size_t bufSize = 0;
+  ssize_t len;
+  while((len = getline(&buf, &bufSize, stdin)) != -1) {
+    StringRef query = StringRef(buf, len).rtrim("\r\n");
+    if (query.empty()) {
+      continue;
+    }
+    StringRef path;
+    unsigned line;
+    if (!parseQuery(query, path, line)) {
+      errs() << "Invalid query " << query << "\n";
+      continue;
+    }
+    outs() << query << (index.contains(path, line) ? " yes" : " no") << "\n";
+    outs().flush(); // answer each query right away
+  }
+  free(buf);
+  return 0;
+}
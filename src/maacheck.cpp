@@ -17,6 +17,9 @@
 
 #include "common.h"
 
+#include <string>
+#include <vector>
+
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instructions.h>
@@ -27,6 +30,8 @@
 
 #include "allocators.h"
 #include "cgclosure.h"
+#include "schedule.h"
+#include "shard.h"
 
 using namespace llvm;
 
@@ -78,9 +83,14 @@ int main(int argc, char* argv[])
   FunctionsSetTy possibleAllocators;
   findPossibleAllocators(m, possibleAllocators); // FIXME: use context-sensitive (more precise) detection
 
-  for(FunctionsVectorTy::iterator FI = functionsOfInterestVector.begin(), FE = functionsOfInterestVector.end(); FI != FE; ++FI) {
+  // functions are checked concurrently, the shared structures are only read
+  unsigned nfuns = functionsOfInterestVector.size();
+  std::vector<std::string> outputs(nfuns);
+
+  parallelForFunctions("maacheck", m, functionsOfInterestVector, [&](unsigned fi) {
 
-    Function *fun = *FI;
+    Function *fun = functionsOfInterestVector[fi];
+    raw_string_ostream out(outputs[fi]);
     auto fisearch = functionsMap.find(fun);
     myassert (fisearch != functionsMap.end());
     FunctionInfo& finfo = fisearch->second;
@@ -124,10 +134,18 @@ int main(int argc, char* argv[])
       }
         
       if (nAllocatingArgs >= 2 && nFreshObjects >= 1 ) {
-        outs() << "WARNING Suspicious call (two or more unprotected arguments) to " << funName(middleFinfo->function) <<
+        out << "WARNING Suspicious call (two or more unprotected arguments) to " << funName(middleFinfo->function) <<
           " at " << funName(finfo.function) << " " << sourceLocation(inst) << "\n";
       }
     }
+    out.flush();
+  });
+
+  for(unsigned fi = 0; fi < nfuns; fi++) {
+    if (!outputs[fi].empty()) {
+      printShardMarker(outs(), functionsOfInterestVector[fi]);
+      outs() << outputs[fi];
+    }
   }
 
   delete m;
@@ -0,0 +1,111 @@
+
+#include "moduleindex.h"
+#include "parallel.h"
+
+#include <memory>
+#include <mutex>
+
+#include <llvm/IR/CallSite.h>
+#include <llvm/IR/GlobalVariable.h>
+
+using namespace llvm;
+
+static void indexFunction(Function *fun, FunctionIndexTy& fi) {
+
+  fi.fun = fun;
+  for(Function::iterator bi = fun->begin(), be = fun->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    IndexedBlockTy b;
+    b.bb = bb;
+    b.callsBegin = fi.callSites.size();
+
+    for(BasicBlock::iterator ii = bb->begin(), ie = bb->end(); ii != ie; ++ii) {
+      Instruction *in = &*ii;
+
+      CallSite cs(in);
+      if (cs) {
+        fi.callSites.push_back({in, cs.getCalledFunction()});
+        continue;
+      }
+      if (AllocaInst *var = dyn_cast<AllocaInst>(in)) {
+        fi.vars.push_back(var);
+        continue;
+      }
+      if (ReturnInst *ret = dyn_cast<ReturnInst>(in)) {
+        fi.returns.push_back(ret);
+        continue;
+      }
+      if (StoreInst *store = dyn_cast<StoreInst>(in)) {
+        Value *ptr = store->getPointerOperand();
+        if (AllocaInst::classof(ptr)) {
+          fi.varStores.push_back(store);
+        }
+        if (GlobalVariable::classof(ptr) || GlobalVariable::classof(store->getValueOperand())) {
+          fi.globalStores.push_back(store);
+        }
+      }
+    }
+    b.callsEnd = fi.callSites.size();
+
+    Instruction *t = bb->getTerminator();
+    if (ReturnInst::classof(t)) {
+      b.terminator = TK_RETURN;
+    } else if (UnreachableInst::classof(t)) {
+      b.terminator = TK_UNREACHABLE;
+    } else {
+      b.terminator = TK_OTHER;
+    }
+    fi.blocks.push_back(b);
+  }
+}
+
+ModuleIndexTy::ModuleIndexTy(Module *m): functions(), functionsIdx(), globalStores(), errorFunctions(), haveErrorFunctions(false) {
+
+  FunctionsVectorTy funs;
+  for(Module::iterator fi = m->begin(), fe = m->end(); fi != fe; ++fi) {
+    Function *fun = &*fi;
+    functionsIdx.insert({fun, funs.size()});
+    funs.push_back(fun);
+  }
+
+  // the IR is only read
+  functions.resize(funs.size());
+  parallelFor(funs.size(), [&](unsigned i) {
+    indexFunction(funs[i], functions[i]);
+  });
+
+  for(std::vector<FunctionIndexTy>::const_iterator fi = functions.begin(), fe = functions.end(); fi != fe; ++fi) {
+    for(StoresVectorTy::const_iterator si = fi->globalStores.begin(), se = fi->globalStores.end(); si != se; ++si) {
+      StoreInst *store = *si;
+      if (GlobalVariable *gv = dyn_cast<GlobalVariable>(store->getPointerOperand())) {
+        globalStores[gv].push_back(store);
+      }
+      GlobalVariable *vgv = dyn_cast<GlobalVariable>(store->getValueOperand());
+      if (vgv && vgv != store->getPointerOperand()) {
+        globalStores[vgv].push_back(store);
+      }
+    }
+  }
+}
+
+ModuleIndexTy& ModuleIndexTy::get(Module *m) {
+
+  static std::mutex indexesMutex;
+  static std::unordered_map<Module*, std::unique_ptr<ModuleIndexTy>> indexes;
+
+  std::lock_guard<std::mutex> lock(indexesMutex);
+  std::unique_ptr<ModuleIndexTy>& idx = indexes[m];
+  if (!idx) {
+    idx.reset(new ModuleIndexTy(m));
+  }
+  return *idx;
+}
+
+const StoresVectorTy* ModuleIndexTy::getGlobalStores(GlobalVariable *gv) const {
+
+  auto gsearch = globalStores.find(gv);
+  if (gsearch == globalStores.end()) {
+    return NULL;
+  }
+  return &gsearch->second;
+}
@@ -0,0 +1,77 @@
+#ifndef RCHK_MODULEINDEX_H
+#define RCHK_MODULEINDEX_H
+
+#include "common.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+
+using namespace llvm;
+
+// an index of the module IR, built in a single pass (in parallel over functions)
+// and shared by the module-level analyses, so that they do not each walk all
+// the instructions again
+//
+// the index is built on first use and is valid as long as the module is
+// not modified
+
+enum TerminatorKindTy {
+  TK_OTHER = 0,
+  TK_RETURN,
+  TK_UNREACHABLE
+};
+
+struct IndexedCallSiteTy {
+  Instruction *inst;
+  Function *target; // NULL for calls through pointers
+};
+
+struct IndexedBlockTy {
+  BasicBlock *bb;
+  unsigned callsBegin; // range in the function's callSites
+  unsigned callsEnd;
+  TerminatorKindTy terminator;
+};
+
+struct FunctionIndexTy {
+  Function *fun;
+  std::vector<IndexedBlockTy> blocks; // in function order
+  std::vector<IndexedCallSiteTy> callSites; // in instruction order
+  std::vector<ReturnInst*> returns;
+  std::vector<AllocaInst*> vars;
+  std::vector<StoreInst*> varStores; // stores to local variables
+  std::vector<StoreInst*> globalStores; // stores to or of global variables
+
+  FunctionIndexTy(): fun(NULL), blocks(), callSites(), returns(), vars(), varStores(), globalStores() {}
+};
+
+typedef std::vector<StoreInst*> StoresVectorTy;
+typedef std::unordered_map<GlobalVariable*, StoresVectorTy> GlobalStoresTy;
+
+class ModuleIndexTy {
+
+  std::vector<FunctionIndexTy> functions; // in module order
+  std::unordered_map<const Function*, unsigned> functionsIdx;
+  GlobalStoresTy globalStores;
+
+  FunctionsSetTy errorFunctions; // cached result of error functions detection
+  bool haveErrorFunctions;
+
+  ModuleIndexTy(Module *m);
+
+  public:
+    static ModuleIndexTy& get(Module *m); // builds the index on first use
+
+    const std::vector<FunctionIndexTy>& getFunctions() const { return functions; }
+    const FunctionIndexTy& getFunction(const Function *f) const { return functions[functionsIdx.at(f)]; }
+    const StoresVectorTy* getGlobalStores(GlobalVariable *gv) const; // stores to or of the variable, NULL if none
+
+    const FunctionsSetTy* getErrorFunctions() const { return haveErrorFunctions ? &errorFunctions : NULL; }
+    void setErrorFunctions(const FunctionsSetTy& errorFunctions) { this->errorFunctions = errorFunctions; haveErrorFunctions = true; }
+};
+
+#endif
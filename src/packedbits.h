@@ -0,0 +1,103 @@
+#ifndef RCHK_PACKEDBITS_H
+#define RCHK_PACKEDBITS_H
+
+#include "common.h"
+
+#include <stdint.h>
+#include <vector>
+
+// bit vector of small fields, used for packed guard states
+//
+// the words are stored inline for small vectors (most functions have only a
+// few guard variables), only larger vectors are stored on the heap
+//
+// bits not stored are implicitly zero, so vectors of different sizes are
+// equal when they only differ in zeros (a packed state does not depend on
+// how many guard variables were known when it was packed)
+
+class PackedBitsTy {
+
+  typedef uint64_t WordTy;
+  static const unsigned WORD_BITS = 64;
+  static const unsigned INLINE_WORDS = 2;
+
+  unsigned nbits;
+  unsigned nwords;
+  WordTy inlineWords[INLINE_WORDS];
+  std::vector<WordTy> heapWords; // only used when nwords > INLINE_WORDS
+
+  WordTy* words() { return (nwords <= INLINE_WORDS) ? inlineWords : heapWords.data(); }
+  const WordTy* words() const { return (nwords <= INLINE_WORDS) ? inlineWords : heapWords.data(); }
+
+  public:
+    PackedBitsTy(unsigned nbits): nbits(nbits), nwords((nbits + WORD_BITS - 1) / WORD_BITS), heapWords() {
+      for(unsigned w = 0; w < INLINE_WORDS; w++) {
+        inlineWords[w] = 0;
+      }
+      if (nwords > INLINE_WORDS) {
+        heapWords.resize(nwords, 0);
+      }
+    }
+
+    unsigned size() const { return nbits; }
+
+    // value of the field of width bits starting at bit base (the lowest bit is bit base)
+    unsigned getField(unsigned base, unsigned width) const {
+      myassert(base + width <= nbits && width < WORD_BITS);
+      unsigned w = base / WORD_BITS;
+      unsigned shift = base % WORD_BITS;
+      WordTy v = words()[w] >> shift;
+      if (shift + width > WORD_BITS) {
+        v |= words()[w + 1] << (WORD_BITS - shift);
+      }
+      return (unsigned) (v & ((((WordTy) 1) << width) - 1));
+    }
+
+    // ors value into the field
+    void setField(unsigned base, unsigned width, unsigned value) {
+      myassert(base + width <= nbits && width < WORD_BITS && value < (1U << width));
+      unsigned w = base / WORD_BITS;
+      unsigned shift = base % WORD_BITS;
+      words()[w] |= ((WordTy) value) << shift;
+      if (shift + width > WORD_BITS) {
+        words()[w + 1] |= ((WordTy) value) >> (WORD_BITS - shift);
+      }
+    }
+
+    // index of the lowest set bit at or above from, or size() when none
+    unsigned findNext(unsigned from) const {
+      if (from >= nbits) {
+        return nbits;
+      }
+      unsigned w = from / WORD_BITS;
+      WordTy v = words()[w] & (~((WordTy) 0) << (from % WORD_BITS));
+      for(;;) {
+        if (v) {
+          return w * WORD_BITS + __builtin_ctzll(v);
+        }
+        if (++w == nwords) {
+          return nbits;
+        }
+        v = words()[w];
+      }
+    }
+
+    bool operator==(const PackedBitsTy& other) const {
+      const WordTy* a = words();
+      const WordTy* b = other.words();
+      unsigned common = (nwords < other.nwords) ? nwords : other.nwords;
+      WordTy diff = 0;
+      for(unsigned w = 0; w < common; w++) { // no early exit, so that it vectorizes
+        diff |= a[w] ^ b[w];
+      }
+      for(unsigned w = common; w < nwords; w++) {
+        diff |= a[w];
+      }
+      for(unsigned w = common; w < other.nwords; w++) {
+        diff |= b[w];
+      }
+      return diff == 0;
+    }
+};
+
+#endif
@@ -0,0 +1,66 @@
+
+#include "parallel.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+unsigned getNumThreads() {
+
+  static unsigned nthreads = 0;
+  if (nthreads) {
+    return nthreads;
+  }
+
+  const char *env = getenv("RCHK_THREADS");
+  if (env) {
+    int n = atoi(env);
+    if (n > 0) {
+      nthreads = n;
+      return nthreads;
+    }
+  }
+
+  nthreads = std::thread::hardware_concurrency();
+  if (!nthreads) {
+    nthreads = 1;
+  }
+  return nthreads;
+}
+
+void parallelFor(unsigned n, const std::function<void(unsigned)>& body, unsigned nthreads) {
+
+  if (nthreads > n) {
+    nthreads = n;
+  }
+  if (nthreads <= 1) {
+    for(unsigned i = 0; i < n; i++) {
+      body(i);
+    }
+    return;
+  }
+
+  // items are handed out dynamically, because their cost differs a lot
+  std::atomic<unsigned> next(0);
+  auto worker = [&]() {
+    for(;;) {
+      unsigned i = next++;
+      if (i >= n) {
+        return;
+      }
+      body(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(unsigned t = 1; t < nthreads; t++) {
+    threads.emplace_back(worker);
+  }
+  worker(); // the calling thread works, too
+  for(std::vector<std::thread>::iterator ti = threads.begin(), te = threads.end(); ti != te; ++ti) {
+    ti->join();
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef RCHK_PARALLEL_H
+#define RCHK_PARALLEL_H
+
+#include "common.h"
+
+#include <functional>
+
+// number of worker threads to use, can be set via environment variable RCHK_THREADS
+//   (defaults to the number of hardware threads)
+unsigned getNumThreads();
+
+// runs body(i) for all i in [0, n), possibly concurrently in up to nthreads threads
+//   the body has to take care of synchronization of any shared state it updates
+void parallelFor(unsigned n, const std::function<void(unsigned)>& body, unsigned nthreads = getNumThreads());
+
+#endif
@@ -0,0 +1,309 @@
+
+#include "profile.h"
+#include "buildid.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <mutex>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/ADT/APInt.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+using namespace llvm;
+
+// the profile file has one line per function (and checks name), with tab-separated fields
+//
+//   function checks irhash intguards sexpguards avoidintguards avoidsexpguards states result
+
+const unsigned PROFILE_FIELDS = 9;
+
+// std::hash and pointer values differ between runs, so this is a simple FNV-style mix
+
+static void mix(uint64_t& h, uint64_t v) {
+  h ^= v;
+  h *= 1099511628211ULL;
+}
+
+static void mix(uint64_t& h, StringRef s) {
+  for(StringRef::iterator ci = s.begin(), ce = s.end(); ci != ce; ++ci) {
+    mix(h, (uint64_t) (unsigned char) *ci);
+  }
+  mix(h, (uint64_t) s.size());
+}
+
+static void mix(uint64_t& h, const APInt& v) {
+  mix(h, (uint64_t) v.getBitWidth());
+  for(unsigned i = 0, nwords = v.getNumWords(); i < nwords; i++) {
+    mix(h, v.getRawData()[i]);
+  }
+}
+
+// local values are numbered in the order of the function (arguments, then blocks and
+// instructions), so that a hash says which value an operand refers to
+
+typedef DenseMap<const Value*, unsigned> ValueNumbersTy;
+
+static void mix(uint64_t& h, Type *t) {
+  std::string str;
+  raw_string_ostream os(str);
+  t->print(os);
+  mix(h, StringRef(os.str()));
+}
+
+static void mixOperand(uint64_t& h, const Value *v, const ValueNumbersTy& numbers) {
+
+  mix(h, (uint64_t) v->getValueID());
+
+  auto nsearch = numbers.find(v);
+  if (nsearch != numbers.end()) {
+    mix(h, (uint64_t) nsearch->second);
+    return;
+  }
+  if (const GlobalValue *gv = dyn_cast<GlobalValue>(v)) {
+    mix(h, gv->getName());
+    return;
+  }
+  if (const ConstantInt *ci = dyn_cast<ConstantInt>(v)) {
+    mix(h, ci->getValue());
+    return;
+  }
+  if (const ConstantFP *cf = dyn_cast<ConstantFP>(v)) {
+    mix(h, cf->getValueAPF().bitcastToAPInt());
+    return;
+  }
+  if (const ConstantDataSequential *cd = dyn_cast<ConstantDataSequential>(v)) {
+    mix(h, cd->getType());
+    mix(h, cd->getRawDataValues());
+    return;
+  }
+  if (const Constant *c = dyn_cast<Constant>(v)) {
+    // aggregates, constant expressions (e.g. addresses of string literals), null, undef
+    mix(h, c->getType());
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(c)) {
+      mix(h, (uint64_t) ce->getOpcode());
+      if (ce->isCompare()) {
+        mix(h, (uint64_t) ce->getPredicate());
+      }
+    }
+    mix(h, (uint64_t) c->getNumOperands());
+    for(unsigned i = 0, nops = c->getNumOperands(); i < nops; i++) {
+      mixOperand(h, c->getOperand(i), numbers);
+    }
+    return;
+  }
+  // metadata (debug info) and inline assembly are not hashed
+}
+
+uint64_t functionIRHash(Function *f) {
+  uint64_t h = 14695981039346656037ULL;
+
+  ValueNumbersTy numbers;
+  for(Function::arg_iterator ai = f->arg_begin(), ae = f->arg_end(); ai != ae; ++ai) {
+    numbers.insert({&*ai, numbers.size()});
+  }
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    numbers.insert({&*bi, numbers.size()});
+    for(BasicBlock::iterator ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
+      numbers.insert({&*ii, numbers.size()});
+    }
+  }
+
+  mix(h, f->getFunctionType());
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    BasicBlock *bb = &*bi;
+    mix(h, (uint64_t) bb->size());
+
+    for(BasicBlock::iterator ii = bb->begin(), ie = bb->end(); ii != ie; ++ii) {
+      Instruction *in = &*ii;
+      mix(h, (uint64_t) in->getOpcode());
+      mix(h, in->getType());
+      mix(h, (uint64_t) in->getNumOperands());
+
+      if (CmpInst *ci = dyn_cast<CmpInst>(in)) {
+        mix(h, (uint64_t) ci->getPredicate());
+      } else if (AllocaInst *ai = dyn_cast<AllocaInst>(in)) {
+        mix(h, ai->getAllocatedType());
+      } else if (GetElementPtrInst *gi = dyn_cast<GetElementPtrInst>(in)) {
+        mix(h, gi->getSourceElementType());
+      } else if (PHINode *phi = dyn_cast<PHINode>(in)) {
+        for(unsigned i = 0, nvals = phi->getNumIncomingValues(); i < nvals; i++) {
+          mixOperand(h, phi->getIncomingBlock(i), numbers);
+        }
+      } else if (ExtractValueInst *ei = dyn_cast<ExtractValueInst>(in)) {
+        for(ExtractValueInst::idx_iterator xi = ei->idx_begin(), xe = ei->idx_end(); xi != xe; ++xi) {
+          mix(h, (uint64_t) *xi);
+        }
+      } else if (InsertValueInst *ii = dyn_cast<InsertValueInst>(in)) {
+        for(InsertValueInst::idx_iterator xi = ii->idx_begin(), xe = ii->idx_end(); xi != xe; ++xi) {
+          mix(h, (uint64_t) *xi);
+        }
+      }
+
+      for(unsigned i = 0, nops = in->getNumOperands(); i < nops; i++) {
+        mixOperand(h, in->getOperand(i), numbers); // includes branch successors and called functions
+      }
+    }
+  }
+  return h;
+}
+
+const char *rchkBuildId() {
+  return RCHK_BUILD_ID;
+}
+
+uint64_t moduleInputsHash(Module *m) {
+
+  static std::mutex hashesMutex;
+  static std::unordered_map<Module*, uint64_t> hashes; // reading the input files again is not free
+
+  std::lock_guard<std::mutex> lock(hashesMutex);
+  auto hsearch = hashes.find(m);
+  if (hsearch != hashes.end()) {
+    return hsearch->second;
+  }
+
+  uint64_t h = 14695981039346656037ULL;
+  mix(h, StringRef(rchkBuildId()));
+  std::vector<std::string> files = moduleInputFiles(m);
+  for(std::vector<std::string>::const_iterator fi = files.begin(), fe = files.end(); fi != fe; ++fi) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(*fi);
+    if (!res) {
+      // cannot tell whether the inputs are the same, make the results unusable by other runs
+      errs() << "Cannot read input file " << *fi << " to identify it\n";
+      mix(h, (uint64_t) getpid());
+      mix(h, (uint64_t) time(NULL));
+      continue;
+    }
+    mix(h, xxHash64(res.get()->getBuffer()));
+  }
+  hashes.insert({m, h});
+  return h;
+}
+
+std::string moduleFileId(Module *m) {
+  std::string id = moduleInputName(m);
+  for(std::string::iterator ci = id.begin(), ce = id.end(); ci != ce; ++ci) {
+    if (!isalnum(*ci) && *ci != '.' && *ci != '-') {
+      *ci = '_';
+    }
+  }
+  return id;
+}
+
+PrecisionProfileTy::PrecisionProfileTy(unsigned long maxStates): fileName(), maxStates(maxStates), entries() {
+
+  const char *env = getenv("RCHK_PROFILE");
+  if (env && *env) {
+    fileName = env;
+    load();
+  }
+}
+
+void PrecisionProfileTy::load() {
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(fileName);
+  if (!res) {
+    return; // first run
+  }
+
+  // what is learned depends on the tool and on the states limit, the profile of a different
+  //   version or limit is not used (and replaced at the end)
+  std::pair<StringRef, StringRef> split = res.get()->getBuffer().split('\n');
+  if (split.first != header()) {
+    errs() << "Ignoring profile " << fileName << ", written by a different build of the tool or with a different states limit\n";
+    return;
+  }
+
+  StringRef rest = split.second;
+  while(!rest.empty()) {
+    split = rest.split('\n');
+    StringRef line = split.first;
+    rest = split.second;
+
+    if (line.empty() || line.startswith("#")) {
+      continue;
+    }
+    SmallVector<StringRef, PROFILE_FIELDS> fields;
+    line.split(fields, '\t');
+
+    FunctionProfileTy p;
+    unsigned intGuards, sexpGuards, avoidInt, avoidSEXP, result;
+    if (fields.size() != PROFILE_FIELDS ||
+        fields[2].getAsInteger(16, p.irHash) ||
+        fields[3].getAsInteger(10, intGuards) ||
+        fields[4].getAsInteger(10, sexpGuards) ||
+        fields[5].getAsInteger(10, avoidInt) ||
+        fields[6].getAsInteger(10, avoidSEXP) ||
+        fields[7].getAsInteger(10, p.states) ||
+        fields[8].getAsInteger(10, result) || result > PR_EXPLODED) {
+
+      errs() << "Ignoring invalid entry in profile " << fileName << ": " << line << "\n";
+      continue;
+    }
+    p.intGuards = intGuards;
+    p.sexpGuards = sexpGuards;
+    p.avoidIntGuards = avoidInt;
+    p.avoidSEXPGuards = avoidSEXP;
+    p.result = (ProfileResultTy) result;
+    entries[fields[0].str() + "\t" + fields[1].str()] = p;
+  }
+}
+
+std::string PrecisionProfileTy::header() const {
+  return "# rchk profile\t" + std::string(rchkBuildId()) + "\t" + std::to_string(maxStates);
+}
+
+const FunctionProfileTy* PrecisionProfileTy::lookup(Function *f, const std::string& checksName) const {
+
+  if (!enabled()) {
+    return NULL;
+  }
+  auto esearch = entries.find(funName(f) + "\t" + checksName);
+  if (esearch == entries.end() || esearch->second.irHash != functionIRHash(f)) {
+    return NULL;
+  }
+  return &esearch->second;
+}
+
+void PrecisionProfileTy::record(Function *f, const std::string& checksName, FunctionProfileTy p) {
+
+  if (!enabled()) {
+    return;
+  }
+  p.irHash = functionIRHash(f);
+  entries[funName(f) + "\t" + checksName] = p;
+}
+
+void PrecisionProfileTy::save() const {
+
+  if (!enabled()) {
+    return;
+  }
+  int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    errs() << "Cannot write profile " << fileName << "\n";
+    return;
+  }
+  raw_fd_ostream out(fd, true);
+
+  out << header() << "\n";
+  out << "# function\tchecks\tirhash\tintguards\tsexpguards\tavoidintguards\tavoidsexpguards\tstates\tresult\n";
+  for(EntriesTy::const_iterator ei = entries.begin(), ee = entries.end(); ei != ee; ++ei) {
+    const FunctionProfileTy& p = ei->second;
+    out << ei->first << "\t" << format_hex_no_prefix(p.irHash, 16) << "\t" << p.intGuards << "\t" << p.sexpGuards << "\t"
+      << p.avoidIntGuards << "\t" << p.avoidSEXPGuards << "\t" << p.states << "\t" << (unsigned) p.result << "\n";
+  }
+}
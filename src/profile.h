@@ -0,0 +1,73 @@
+#ifndef RCHK_PROFILE_H
+#define RCHK_PROFILE_H
+
+#include "common.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+
+using namespace llvm;
+
+// precision profile: what was learned about checking a function in previous runs
+//
+// when environment variable RCHK_PROFILE is set to a file name, the profile is read from that
+// file (if it exists) at startup and written back at the end; entries are only used when the
+// function has not changed (the hash of its IR is the same), and the profile is only used when it
+// has been written by the same build of the tool with the same states limit
+
+enum ProfileResultTy {
+  PR_COMPLETED = 0,		// checking completed with the recorded guards
+  PR_GUARDS_EXPLODED,		// checking hit the states limit, a guard kind has been avoided since
+  PR_EXPLODED			// checking hit the states limit even without guards
+};
+
+struct FunctionProfileTy {
+  uint64_t irHash;
+  bool intGuards;		// guards enabled in the last checking phase (sufficient precision)
+  bool sexpGuards;
+  bool avoidIntGuards;		// guard kinds known to explode
+  bool avoidSEXPGuards;
+  unsigned long states;		// states explored in the last checking phase
+  ProfileResultTy result;
+
+  FunctionProfileTy(): irHash(0), intGuards(false), sexpGuards(false), avoidIntGuards(false), avoidSEXPGuards(false), states(0), result(PR_COMPLETED) {}
+};
+
+class PrecisionProfileTy {
+
+  typedef std::map<std::string, FunctionProfileTy> EntriesTy; // keyed by function and checks name
+
+  std::string fileName;
+  unsigned long maxStates;
+  EntriesTy entries;
+
+  void load();
+  std::string header() const; // identifies the build and the states limit
+
+  public:
+    PrecisionProfileTy(unsigned long maxStates);
+
+    bool enabled() const { return !fileName.empty(); }
+    const FunctionProfileTy* lookup(Function *f, const std::string& checksName) const; // NULL if unknown or changed
+    void record(Function *f, const std::string& checksName, FunctionProfileTy p);
+    void save() const;
+};
+
+// hash of the function's IR, stable between runs
+uint64_t functionIRHash(Function *f);
+
+// identifier of the rchk build (changes with the sources and the LLVM version)
+const char *rchkBuildId();
+
+// hash of the contents of the input files of the module and of the rchk build, stable between runs;
+// results saved by a run can be reused by a run with the same hash
+uint64_t moduleInputsHash(Module *m);
+
+// module identifier usable as part of a file name (of the module file when checking a package)
+std::string moduleFileId(Module *m);
+
+#endif
@@ -0,0 +1,175 @@
+
+#include "schedule.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <map>
+#include <string>
+#include <sys/file.h>
+#include <unistd.h>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+// the schedule file has one line per tool, module and function, with tab-separated fields
+//
+//   tool module function seconds
+//
+// the time of the whole module is recorded with function name "*"; the module is the module file
+// when checking a package (not the base it is linked with)
+
+const unsigned SCHEDULE_FIELDS = 4;
+const std::string MODULE_ENTRY = "*";
+
+typedef std::map<std::string, double> CostsTy; // keyed by tool, module and function
+
+static void loadCosts(const std::string& fileName, CostsTy& costs) {
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(fileName);
+  if (!res) {
+    return; // first run
+  }
+
+  StringRef rest = res.get()->getBuffer();
+  while(!rest.empty()) {
+    std::pair<StringRef, StringRef> split = rest.split('\n');
+    StringRef line = split.first;
+    rest = split.second;
+
+    if (line.empty() || line.startswith("#")) {
+      continue;
+    }
+    SmallVector<StringRef, SCHEDULE_FIELDS> fields;
+    line.split(fields, '\t');
+
+    double seconds;
+    if (fields.size() != SCHEDULE_FIELDS || fields[3].getAsDouble(seconds) || seconds < 0) {
+      errs() << "Ignoring invalid entry in schedule " << fileName << ": " << line << "\n";
+      continue;
+    }
+    costs[fields[0].str() + "\t" + fields[1].str() + "\t" + fields[2].str()] = seconds;
+  }
+}
+
+static void saveCosts(const std::string& fileName, const CostsTy& costs) {
+
+  // other tools may have updated the file meanwhile, replace it atomically
+  std::string tmpName = fileName + "." + std::to_string(getpid());
+  int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    errs() << "Cannot write schedule " << tmpName << "\n";
+    return;
+  }
+  {
+    raw_fd_ostream out(fd, true);
+    out << "# tool\tmodule\tfunction\tseconds\n";
+    for(CostsTy::const_iterator ci = costs.begin(), ce = costs.end(); ci != ce; ++ci) {
+      out << ci->first << "\t" << format("%.6f", ci->second) << "\n";
+    }
+  }
+  if (rename(tmpName.c_str(), fileName.c_str())) {
+    errs() << "Cannot write schedule " << fileName << "\n";
+    unlink(tmpName.c_str());
+  }
+}
+
+unsigned functionSize(Function *f) {
+  unsigned size = 0;
+  for(Function::iterator bi = f->begin(), be = f->end(); bi != be; ++bi) {
+    size += bi->size();
+  }
+  return size;
+}
+
+void parallelForFunctions(const std::string& tool, Module *m, const FunctionsVectorTy& funs, const std::function<void(unsigned)>& body,
+  unsigned nthreads) {
+
+  std::string fileName;
+  const char *env = getenv("RCHK_SCHEDULE");
+  if (env && *env) {
+    fileName = env;
+  }
+  std::string prefix = tool + "\t" + moduleInputName(m) + "\t";
+
+  CostsTy costs;
+  if (!fileName.empty()) {
+    loadCosts(fileName, costs);
+  }
+
+  // expected costs, functions not timed before are estimated from their size
+  //   using the time per instruction of the functions that were timed
+  unsigned n = funs.size();
+  std::vector<double> expected(n, -1);
+  std::vector<unsigned> sizes(n);
+  double knownSeconds = 0;
+  double knownSize = 0;
+
+  for(unsigned i = 0; i < n; i++) {
+    sizes[i] = functionSize(funs[i]);
+    auto csearch = costs.find(prefix + funName(funs[i]));
+    if (csearch != costs.end()) {
+      expected[i] = csearch->second;
+      knownSeconds += csearch->second;
+      knownSize += sizes[i];
+    }
+  }
+  double secondsPerInstruction = (knownSeconds > 0 && knownSize > 0) ? knownSeconds / knownSize : 1;
+  for(unsigned i = 0; i < n; i++) {
+    if (expected[i] < 0) {
+      expected[i] = sizes[i] * secondsPerInstruction;
+    }
+  }
+
+  // longest first, ties broken by the original order to keep runs repeatable
+  std::vector<unsigned> order(n);
+  for(unsigned i = 0; i < n; i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return expected[a] > expected[b];
+  });
+
+  std::vector<double> seconds(n, 0);
+  auto start = std::chrono::steady_clock::now();
+
+  parallelFor(n, [&](unsigned k) {
+    unsigned i = order[k];
+    auto fstart = std::chrono::steady_clock::now();
+    body(i);
+    seconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - fstart).count();
+  }, nthreads);
+
+  if (fileName.empty()) {
+    return;
+  }
+
+  // re-read the file, it may be shared with other tools and modules running meanwhile; the update
+  //   is done under a lock, so that concurrent updates are not lost
+  std::string lockName = fileName + ".lock";
+  int lockfd = open(lockName.c_str(), O_WRONLY | O_CREAT, 0666);
+  if (lockfd < 0 || flock(lockfd, LOCK_EX)) {
+    errs() << "Cannot lock schedule " << lockName << "\n";
+    if (lockfd >= 0) {
+      close(lockfd);
+    }
+    return;
+  }
+  costs.clear();
+  loadCosts(fileName, costs);
+  for(unsigned i = 0; i < n; i++) {
+    costs[prefix + funName(funs[i])] = seconds[i];
+  }
+  costs[prefix + MODULE_ENTRY] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  saveCosts(fileName, costs);
+  close(lockfd); // releases the lock
+}
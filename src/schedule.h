@@ -0,0 +1,28 @@
+#ifndef RCHK_SCHEDULE_H
+#define RCHK_SCHEDULE_H
+
+#include "common.h"
+#include "parallel.h"
+
+#include <functional>
+
+#include <llvm/IR/Module.h>
+
+using namespace llvm;
+
+// like parallelFor over functions funs, but starting the functions expected to take longest first
+//   (longest-processing-time-first scheduling), so that a slow function started late does not
+//   determine the total time
+//
+// the expected times are read from the file given by environment variable RCHK_SCHEDULE, written
+// by previous runs of the tool on the same module; functions not found there are estimated from
+// their size; the file is then updated with the times of this run (per function and for the
+// whole module)
+
+// number of instructions of the function
+unsigned functionSize(Function *f);
+
+void parallelForFunctions(const std::string& tool, Module *m, const FunctionsVectorTy& funs, const std::function<void(unsigned)>& body,
+  unsigned nthreads = getNumThreads());
+
+#endif
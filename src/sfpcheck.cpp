@@ -19,7 +19,6 @@
 
 #include "allocators.h"
 #include "cgclosure.h"
-#include "exceptions.h"
 #include "lannotate.h"
 
 using namespace llvm;
@@ -33,9 +32,7 @@ int main(int argc, char* argv[])
   Module *m = parseArgsReadIR(argc, argv, functionsOfInterestSet, functionsOfInterestVector, context);
   
   FunctionsInfoMapTy functionsMap;
-  buildCGClosure(m, functionsMap, true /* ignore error paths */);
-  
-  unsigned gcFunctionIndex = getGCFunctionIndex(functionsMap, m);
+  buildCGClosure(m, functionsMap, true /* ignore error paths */, NULL, NULL, NULL, getGCFunction(m), false /* only reachesGC needed */);
   
   errs() << "List of functions and callsites calling (recursively) into " << gcFunction << ":\n";
 
@@ -54,12 +51,8 @@ int main(int argc, char* argv[])
       const CallInfo& cinfo = *CI;
       const FunctionInfo *middleFinfo = cinfo.target;
         
-      for(std::vector<FunctionInfo*>::const_iterator TFI = middleFinfo->calledFunctionsList.begin(), TFE = middleFinfo->calledFunctionsList.end(); TFI != TFE; ++TFI) {
-        const FunctionInfo *targetFinfo = *TFI;
-          
-        if ((targetFinfo->callsFunctionMap)[gcFunctionIndex] && !isAssertedNonAllocating(const_cast<Function*>(targetFinfo->function))) {
-          annotateLine(sfpLines, cinfo.instruction);        
-        }
+      if (middleFinfo->reachesGC) {
+        annotateLine(sfpLines, cinfo.instruction);        
       }
     }
   }
@@ -0,0 +1,143 @@
+
+#include "shard.h"
+#include "schedule.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+
+#include <llvm/ADT/StringRef.h>
+
+using namespace llvm;
+
+unsigned shardIndex = 0;
+unsigned shardCount = 1;
+
+static std::unordered_map<Function*, unsigned> shardPositions; // position of function in the unsharded order
+
+static void shardUsage(const char *tool) {
+  errs() << tool << ": invalid shard, use --shard i/N with 1 <= i <= N\n";
+  exit(1);
+}
+
+void parseShardArg(int& argc, char* argv[]) {
+
+  for(int i = 1; i < argc; i++) {
+    StringRef arg = argv[i];
+    StringRef spec;
+    int nargs;
+
+    if (arg == "--shard" && i + 1 < argc) {
+      spec = argv[i + 1];
+      nargs = 2;
+    } else if (arg.startswith("--shard=")) {
+      spec = arg.drop_front(strlen("--shard="));
+      nargs = 1;
+    } else {
+      continue;
+    }
+
+    std::pair<StringRef, StringRef> split = spec.split('/');
+    unsigned index, count;
+    if (split.first.getAsInteger(10, index) || split.second.getAsInteger(10, count) || index < 1 || index > count) {
+      shardUsage(argv[0]);
+    }
+    shardIndex = index - 1;
+    shardCount = count;
+
+    for(int j = i + nargs; j <= argc; j++) { // including the terminating NULL
+      argv[j - nargs] = argv[j];
+    }
+    argc -= nargs;
+    return;
+  }
+}
+
+static uint64_t nameHash(StringRef name) {
+  uint64_t h = 14695981039346656037ULL;
+  for(StringRef::iterator ci = name.begin(), ce = name.end(); ci != ce; ++ci) {
+    h ^= (unsigned char) *ci;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static bool shardByHash() {
+  const char *env = getenv("RCHK_SHARD_BY");
+  return env && !strcmp(env, "hash");
+}
+
+std::string shardFileId() {
+  if (shardCount == 1) {
+    return "";
+  }
+  return "shard" + std::to_string(shardIndex + 1) + "-of-" + std::to_string(shardCount) + (shardByHash() ? "-hash" : "-size");
+}
+
+// assigns each function (by position) to a shard, all shards have to compute the same assignment
+
+static void assignShards(const FunctionsVectorTy& funs, std::vector<unsigned>& shards) {
+
+  unsigned n = funs.size();
+  shards.resize(n);
+
+  if (shardByHash()) {
+    for(unsigned i = 0; i < n; i++) {
+      shards[i] = nameHash(funs[i]->getName()) % shardCount;
+    }
+    return;
+  }
+
+  // largest first, each to the shard with the smallest total size so far
+  std::vector<unsigned> sizes(n);
+  std::vector<unsigned> order(n);
+  for(unsigned i = 0; i < n; i++) {
+    sizes[i] = functionSize(funs[i]);
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&sizes](unsigned a, unsigned b) {
+    return sizes[a] > sizes[b];
+  });
+
+  std::vector<uint64_t> loads(shardCount, 0);
+  for(std::vector<unsigned>::const_iterator oi = order.begin(), oe = order.end(); oi != oe; ++oi) {
+    unsigned s = std::min_element(loads.begin(), loads.end()) - loads.begin();
+    shards[*oi] = s;
+    loads[s] += sizes[*oi] + 1; // empty functions still take some time
+  }
+}
+
+void selectShard(FunctionsOrderedSetTy& functionsOfInterestSet, FunctionsVectorTy& functionsOfInterestVector) {
+
+  if (shardCount == 1) {
+    return;
+  }
+
+  std::vector<unsigned> shards;
+  assignShards(functionsOfInterestVector, shards);
+
+  FunctionsVectorTy selected;
+  for(unsigned i = 0, n = functionsOfInterestVector.size(); i < n; i++) {
+    Function *f = functionsOfInterestVector[i];
+    if (shards[i] == shardIndex) {
+      selected.push_back(f);
+      shardPositions.insert({f, i});
+    } else {
+      functionsOfInterestSet.erase(f);
+    }
+  }
+  functionsOfInterestVector.swap(selected);
+}
+
+void printShardMarker(raw_ostream& out, Function *f) {
+
+  if (shardCount == 1) {
+    return;
+  }
+  auto psearch = shardPositions.find(f);
+  if (psearch != shardPositions.end()) {
+    out << "#shard " << psearch->second << " " << f->getName() << "\n";
+  }
+}
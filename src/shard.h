@@ -0,0 +1,39 @@
+#ifndef RCHK_SHARD_H
+#define RCHK_SHARD_H
+
+#include "common.h"
+
+#include <llvm/IR/Function.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+// sharding: with option --shard i/N, a tool only checks the i-th (1 <= i <= N) of N slices of the
+// functions of interest, so that N processes (possibly on different machines) can check a module
+// together
+//
+// the slices are deterministic, by default they are balanced by the size of the functions
+// (largest function first to the smallest slice), with environment variable RCHK_SHARD_BY=hash
+// a function is in the slice given by a hash of its name (which does not move other functions
+// when a function is added or changed)
+//
+// each output of a function in a sharded run is preceded by a marker line with the position of
+// the function in the whole (unsharded) order, so that tool shardmerge can put the outputs of the
+// shards together in the same order as from a single process
+
+extern unsigned shardIndex; // 0-based
+extern unsigned shardCount; // 1 when not sharding
+
+// removes the option from the arguments (if present), exits on invalid option
+void parseShardArg(int& argc, char* argv[]);
+
+// restricts the (sorted) functions of interest to the current shard
+void selectShard(FunctionsOrderedSetTy& functionsOfInterestSet, FunctionsVectorTy& functionsOfInterestVector);
+
+// identifies the current shard (and how the slices are computed) in file names, empty when not sharding
+std::string shardFileId();
+
+// prints the marker of function f when sharding
+void printShardMarker(raw_ostream& out, Function *f);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+  Merge the outputs of a sharded run of a checking tool (see shard.h).
+
+    shardmerge [-l] shard_output ...
+
+  prints the outputs of the shards (standard outputs of the tool run with
+  --shard 1/N to --shard N/N, in any order) as they would be printed by a
+  single process.  The output of each function is preceded by a marker line
+  with its position in the whole run (bcheck, maacheck, ueacheck, errcheck),
+  the outputs are printed by these positions and the markers are dropped.
+  Text before the first marker is printed only once when it is the same in
+  all shards.
+
+  With -l, the outputs are lists of source lines "path line_number" (the
+  output of csfpcheck and sfpcheck), which are merged into a single sorted
+  list without duplicates.  Other lines are printed first.
+*/
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+const StringRef MARKER = "#shard ";
+
+struct ChunkTy {
+  unsigned position; // of the function in the whole run
+  unsigned shard; // index of the input
+  unsigned seq; // order in the input
+  StringRef text;
+};
+
+struct SourceLineTy {
+  std::string path;
+  unsigned line;
+
+  bool operator<(const SourceLineTy& other) const { // as LineTy_compare in lannotate.h
+    int cmp = path.compare(other.path);
+    if (cmp) {
+      return cmp < 0;
+    }
+    return line < other.line;
+  }
+};
+
+// splits an output into the text before the first marker and the chunks following the markers
+
+static bool splitOutput(StringRef text, unsigned shard, StringRef& preamble, std::vector<ChunkTy>& chunks, const char *fname) {
+
+  size_t pos = text.startswith(MARKER) ? 0 : text.find("\n" + MARKER.str());
+  if (pos == StringRef::npos) {
+    preamble = text;
+    return true;
+  }
+  if (pos) {
+    pos++; // include the newline
+  }
+  preamble = text.substr(0, pos);
+  text = text.substr(pos);
+
+  unsigned seq = 0;
+  while(!text.empty()) {
+    std::pair<StringRef, StringRef> split = text.split('\n');
+    StringRef marker = split.first.drop_front(MARKER.size());
+    ChunkTy c;
+    if (marker.split(' ').first.getAsInteger(10, c.position)) {
+      errs() << "Invalid shard marker in " << fname << ": " << split.first << "\n";
+      return false;
+    }
+    c.shard = shard;
+    c.seq = seq++;
+
+    StringRef rest = split.second;
+    size_t end = rest.startswith(MARKER) ? 0 : rest.find("\n" + MARKER.str());
+    if (end != StringRef::npos && end) {
+      end++;
+    }
+    c.text = rest.substr(0, end);
+    chunks.push_back(c);
+    text = rest.substr(c.text.size());
+  }
+  return true;
+}
+
+static void mergeChunks(const std::vector<std::unique_ptr<MemoryBuffer>>& outputs, const std::vector<const char*>& fnames, bool& ok) {
+
+  std::vector<StringRef> preambles;
+  std::vector<ChunkTy> chunks;
+
+  for(unsigned i = 0; i < outputs.size(); i++) {
+    StringRef preamble;
+    if (!splitOutput(outputs[i]->getBuffer(), i, preamble, chunks, fnames[i])) {
+      ok = false;
+      return;
+    }
+    preambles.push_back(preamble);
+  }
+
+  bool samePreambles = true;
+  for(unsigned i = 1; i < preambles.size(); i++) {
+    samePreambles = samePreambles && preambles[i] == preambles[0];
+  }
+  for(unsigned i = 0; i < preambles.size(); i++) {
+    if (!samePreambles || i == 0) {
+      outs() << preambles[i];
+    }
+  }
+
+  std::sort(chunks.begin(), chunks.end(), [](const ChunkTy& a, const ChunkTy& b) {
+    if (a.position != b.position) {
+      return a.position < b.position;
+    }
+    if (a.shard != b.shard) {
+      return a.shard < b.shard;
+    }
+    return a.seq < b.seq;
+  });
+  for(std::vector<ChunkTy>::const_iterator ci = chunks.begin(), ce = chunks.end(); ci != ce; ++ci) {
+    outs() << ci->text;
+  }
+}
+
+static void mergeLines(const std::vector<std::unique_ptr<MemoryBuffer>>& outputs) {
+
+  std::vector<StringRef> others; // in the order of inputs, without duplicates
+  std::set<StringRef> seenOthers;
+  std::set<SourceLineTy> lines;
+
+  for(unsigned i = 0; i < outputs.size(); i++) {
+    StringRef rest = outputs[i]->getBuffer();
+    while(!rest.empty()) {
+      std::pair<StringRef, StringRef> split = rest.split('\n');
+      StringRef line = split.first;
+      rest = split.second;
+
+      std::pair<StringRef, StringRef> fields = line.rsplit(' ');
+      SourceLineTy sl;
+      if (fields.first.empty() || fields.second.getAsInteger(10, sl.line)) {
+        if (seenOthers.insert(line).second) {
+          others.push_back(line);
+        }
+        continue;
+      }
+      sl.path = fields.first.str();
+      lines.insert(sl);
+    }
+  }
+
+  for(std::vector<StringRef>::const_iterator oi = others.begin(), oe = others.end(); oi != oe; ++oi) {
+    outs() << *oi << "\n";
+  }
+  for(std::set<SourceLineTy>::const_iterator li = lines.begin(), le = lines.end(); li != le; ++li) {
+    outs() << li->path << " " << li->line << "\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  bool sourceLines = false;
+  int argi = 1;
+
+  if (argi < argc && !strcmp(argv[argi], "-l")) {
+    sourceLines = true;
+    argi++;
+  }
+  if (argi == argc) {
+    errs() << argv[0] << " [-l] shard_output ...\n";
+    return 2;
+  }
+
+  std::vector<std::unique_ptr<MemoryBuffer>> outputs;
+  std::vector<const char*> fnames;
+  for(; argi < argc; argi++) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> res = MemoryBuffer::getFile(argv[argi]);
+    if (!res) {
+      errs() << "Cannot read " << argv[argi] << ": " << res.getError().message() << "\n";
+      return 2;
+    }
+    outputs.push_back(std::move(res.get()));
+    fnames.push_back(argv[argi]);
+  }
+
+  bool ok = true;
+  if (sourceLines) {
+    mergeLines(outputs);
+  } else {
+    mergeChunks(outputs, fnames, ok);
+  }
+  return ok ? 0 : 1;
+}
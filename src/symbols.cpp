@@ -1,5 +1,6 @@
 
 #include "symbols.h"
+#include "moduleindex.h"
 
 using namespace llvm;
 
@@ -54,6 +55,7 @@ bool isInstallConstantCall(Value *inst, std::string& symbolName) {
 
 void findSymbols(Module *m, SymbolsMapTy* symbolsMap) {
 
+  const ModuleIndexTy& index = ModuleIndexTy::get(m);
   for(Module::global_iterator gi = m->global_begin(), ge = m->global_end(); gi != ge ; ++gi) {
     GlobalVariable *gv = &*gi;
     if (!isSEXP(gv)) {
@@ -61,13 +63,13 @@ void findSymbols(Module *m, SymbolsMapTy* symbolsMap) {
     }
     bool foundInstall = false;
     std::string symbolName;
+    const StoresVectorTy* stores = index.getGlobalStores(gv);
+    if (!stores) {
+      continue;
+    }
     
-    for(Value::user_iterator ui = gv->user_begin(), ue = gv->user_end(); ui != ue; ++ui) {
-      User *u = *ui;
-      if (!StoreInst::classof(u)) {
-        continue;
-      }
-      Value *valueOp = cast<StoreInst>(u)->getValueOperand();
+    for(StoresVectorTy::const_iterator si = stores->begin(), se = stores->end(); si != se; ++si) {
+      Value *valueOp = (*si)->getValueOperand();
       std::string name;
       if (isInstallConstantCall(valueOp, name)) {
         if (!foundInstall) {
@@ -60,6 +60,14 @@ template <
       index.push_back(intr);
       return intr;
     }
+
+    const Member* find(const Member& m) const { // NULL if not interned
+      auto msearch = table.find(m);
+      if (msearch == table.end()) {
+        return NULL;
+      }
+      return &*msearch;
+    }
     
     const Member* intern(const Member *m) {
       if (!m) {
@@ -9,6 +9,11 @@
 
 #include "common.h"
        
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Dominators.h>
@@ -24,16 +29,93 @@
 
 #include "allocators.h"
 #include "cgclosure.h"
+#include "schedule.h"
+#include "shard.h"
 
 using namespace llvm;
 
 const bool VERBOSE = false;
 
-// FIXME: it might be better looking for an allocating store that is closest
-// to the use, to reduce false alarms
+// information about a local SEXP variable, collected once per function from
+// the users of the variable, so that queries for individual arguments do not
+// have to walk the users again
+
+struct VarInfoTy {
+  std::vector<StoreInst*> allocatingStores; // stores of fresh objects not passed anywhere else
+  std::vector<std::pair<LoadInst*, Instruction*>> protects; // PROTECT(var): load of the variable and the protect call
+  bool mayBeCaptured; // captured anywhere in the function
+
+  VarInfoTy(): allocatingStores(), protects(), mayBeCaptured(true) {}
+};
+
+typedef std::unordered_map<AllocaInst*, VarInfoTy> VarsInfoTy;
+
+struct CaptureKeyTy {
+  AllocaInst *var;
+  Instruction *before;
+
+  CaptureKeyTy(AllocaInst *var, Instruction *before): var(var), before(before) {}
+  bool operator==(const CaptureKeyTy& other) const { return var == other.var && before == other.before; }
+};
+
+struct CaptureKeyTy_hash {
+  size_t operator()(const CaptureKeyTy& k) const {
+    size_t res = 0;
+    hash_combine(res, k.var);
+    hash_combine(res, k.before);
+    return res;
+  }
+};
+
+typedef std::unordered_map<CaptureKeyTy, bool, CaptureKeyTy_hash> CapturesTy;
+
+// checker state for a single function
+//   each function is checked by a single thread, the output is buffered
+//   and printed in the order of functions
+
+class FunctionCheckerTy {
+
+  FunctionsSetTy& possibleAllocators;
+  DominatorTree dominatorTree;
+  VarsInfoTy vars;
+  CapturesTy captures;
+
+  public:
+    raw_ostream& out;
+
+    FunctionCheckerTy(Function *f, FunctionsSetTy& possibleAllocators, raw_ostream& out):
+      possibleAllocators(possibleAllocators), dominatorTree(), vars(), captures(), out(out) {
+
+      dominatorTree.recalculate(*f);
+    }
+
+    const VarInfoTy& varInfo(AllocaInst *v);
+    bool mayBeCapturedBefore(AllocaInst *v, Instruction *callInst);
+    StoreInst* getDominatingNonProtectingAllocatingStore(AllocaInst *v, const Instruction *useInst);
+    Instruction* getProtect(AllocaInst *v, const StoreInst *allocStore, const Instruction *useInst);
+    bool isLoadOfUnprotectedObject(Value *arg, Instruction *callInst);
+};
+
+const VarInfoTy& FunctionCheckerTy::varInfo(AllocaInst *v) {
+
+  auto vsearch = vars.find(v);
+  if (vsearch != vars.end()) {
+    return vsearch->second;
+  }
+  VarInfoTy& vi = vars[v];
 
-StoreInst* getDominatingNonProtectingAllocatingStore(AllocaInst *v, const Instruction *useInst, FunctionsSetTy& possibleAllocators, DominatorTree& dominatorTree) {
   for (Value::user_iterator ui = v->user_begin(), ue = v->user_end(); ui != ue; ++ui) {
+
+    if (LoadInst *l = dyn_cast<LoadInst>(*ui)) {
+      for(Value::user_iterator lui = l->user_begin(), lue = l->user_end(); lui != lue; ++lui) {
+        CallSite cs(*lui);
+        if (cs && isProtectingFunction(cs.getCalledFunction())) {
+          vi.protects.push_back({l, cs.getInstruction()});
+        }
+      }
+      continue;
+    }
+
     if (!StoreInst::classof(*ui)) {
       continue;
     }
@@ -52,12 +134,10 @@ StoreInst* getDominatingNonProtectingAllocatingStore(AllocaInst *v, const Instru
     if (possibleAllocators.find(f) == possibleAllocators.end()) {
       continue;
     }
-    if (!dominatorTree.dominates(s, useInst)) {
-      continue;
-    }
     // check that the value returned by the allocating call is not passed anywhere else
     if (ssrc->hasOneUse()) {
-      return s;
+      vi.allocatingStores.push_back(s);
+      continue;
     }
     if (ssrc->hasNUses(2)) {
       // also allow a store and a call to protect
@@ -71,38 +151,50 @@ StoreInst* getDominatingNonProtectingAllocatingStore(AllocaInst *v, const Instru
 
       CallSite pcs(u);
       if (pcs && isProtectingFunction(pcs.getCalledFunction())) {
-        return s;
+        vi.allocatingStores.push_back(s);
       }
     }
   }
+
+  // a variable not captured at all cannot be captured before a particular instruction
+  vi.mayBeCaptured = PointerMayBeCaptured(v, false, true);
+  return vi;
+}
+
+bool FunctionCheckerTy::mayBeCapturedBefore(AllocaInst *v, Instruction *callInst) {
+
+  if (!varInfo(v).mayBeCaptured) {
+    return false;
+  }
+  auto cinsert = captures.insert({CaptureKeyTy(v, callInst), false});
+  if (cinsert.second) {
+    cinsert.first->second = PointerMayBeCapturedBefore(v, false, true, callInst, &dominatorTree, true);
+  }
+  return cinsert.first->second;
+}
+
+// FIXME: it might be better looking for an allocating store that is closest
+// to the use, to reduce false alarms
+
+StoreInst* FunctionCheckerTy::getDominatingNonProtectingAllocatingStore(AllocaInst *v, const Instruction *useInst) {
+
+  const VarInfoTy& vi = varInfo(v);
+  for(std::vector<StoreInst*>::const_iterator si = vi.allocatingStores.begin(), se = vi.allocatingStores.end(); si != se; ++si) {
+    if (dominatorTree.dominates(*si, useInst)) {
+      return *si;
+    }
+  }
   return NULL;
 }
 
 // FIXME: there should be a way to offload this to capture (/escape) analysis
-Instruction* getProtect(AllocaInst *v, const StoreInst *allocStore, const Instruction *useInst, DominatorTree& dominatorTree) {
+Instruction* FunctionCheckerTy::getProtect(AllocaInst *v, const StoreInst *allocStore, const Instruction *useInst) {
 
   // look for PROTECT(var)
-  for (Value::user_iterator ui = v->user_begin(), ue = v->user_end(); ui != ue; ++ui) {
-    if (!LoadInst::classof(*ui)) {
-      continue;
-    }
-    LoadInst *l = cast<LoadInst>(*ui);
-    for(Value::user_iterator lui = l->user_begin(), lue = l->user_end(); lui != lue; ++lui) {
-      Value *luv = *lui;
-      CallSite cs(luv);
-      if (!cs || !cs.getCalledFunction()) {
-        continue;
-      }
-      if (!dominatorTree.dominates(cs.getInstruction(), useInst)) {
-        continue;
-      }
-      if (!dominatorTree.dominates(allocStore, l)) {
-        continue;
-      }
-      if (!isProtectingFunction(cs.getCalledFunction())) {
-        continue;
-      }
-      return cs.getInstruction();
+  const VarInfoTy& vi = varInfo(v);
+  for(std::vector<std::pair<LoadInst*, Instruction*>>::const_iterator pi = vi.protects.begin(), pe = vi.protects.end(); pi != pe; ++pi) {
+    if (dominatorTree.dominates(pi->second, useInst) && dominatorTree.dominates(allocStore, pi->first)) {
+      return pi->second;
     }
   }
 
@@ -165,7 +257,7 @@ ArgExpKind classifyArgumentExpression(Value *arg, FunctionsInfoMapTy& functionsM
 
 
 // this is approximative only
-bool isLoadOfUnprotectedObject(Value *arg, Instruction *callInst, FunctionsSetTy& possibleAllocators, DominatorTree& dominatorTree) {
+bool FunctionCheckerTy::isLoadOfUnprotectedObject(Value *arg, Instruction *callInst) {
   if (!LoadInst::classof(arg)) {
     return false;
   }
@@ -174,17 +266,18 @@ bool isLoadOfUnprotectedObject(Value *arg, Instruction *callInst, FunctionsSetTy
   if (!AllocaInst::classof(v) || !isSEXP(cast<AllocaInst>(v))) { // FIXME: does not handle phi nodes
     return false;
   }
-  if (PointerMayBeCapturedBefore(v, false, true, callInst, &dominatorTree, true)) {
+  AllocaInst *var = cast<AllocaInst>(v);
+  if (mayBeCapturedBefore(var, callInst)) {
     return false;
   }
-  StoreInst* allocStore = getDominatingNonProtectingAllocatingStore(cast<AllocaInst>(v), cast<LoadInst>(arg), possibleAllocators, dominatorTree);
+  StoreInst* allocStore = getDominatingNonProtectingAllocatingStore(var, cast<LoadInst>(arg));
   if (!allocStore) {
     return false;
   }
-  Instruction* protect = getProtect(cast<AllocaInst>(v), allocStore, cast<LoadInst>(arg), dominatorTree);
+  Instruction* protect = getProtect(var, allocStore, cast<LoadInst>(arg));
   if (!protect) {
     if (VERBOSE) {
-      outs() << "Variable " << *v << " may be unprotected in call " << sourceLocation(callInst) << " with allocation at  "
+      out << "Variable " << *v << " may be unprotected in call " << sourceLocation(callInst) << " with allocation at  "
         << sourceLocation(allocStore) << "\n";
     }
     return true;
@@ -208,20 +301,22 @@ int main(int argc, char* argv[])
   FunctionsSetTy possibleAllocators;
   findPossibleAllocators(m, possibleAllocators); // FIXME: use context-sensitive (more precise) allocator detection
 
-  DominatorTreeWrapperPass dtPass;
+  // functions are checked concurrently, the shared structures are only read
+  unsigned nfuns = functionsOfInterestVector.size();
+  std::vector<std::string> outputs(nfuns);
 
-  for(FunctionsVectorTy::iterator FI = functionsOfInterestVector.begin(), FE = functionsOfInterestVector.end(); FI != FE; ++FI) {
+  parallelForFunctions("ueacheck", m, functionsOfInterestVector, [&](unsigned fi) {
 
-    auto fisearch = functionsMap.find(*FI);
+    auto fisearch = functionsMap.find(functionsOfInterestVector[fi]);
     myassert (fisearch != functionsMap.end());
     FunctionInfo& finfo = fisearch->second;
 
     if (finfo.function->empty()) {
-      continue;
+      return;
     }
 
-    dtPass.runOnFunction(*const_cast<Function*>(finfo.function));
-    DominatorTree& dominatorTree = dtPass.getDomTree();
+    raw_string_ostream out(outputs[fi]);
+    FunctionCheckerTy checker(const_cast<Function*>(finfo.function), possibleAllocators, out);
     
     for(std::vector<CallInfo>::const_iterator CI = finfo.callInfos.begin(), CE = finfo.callInfos.end(); CI != CE; ++CI) {
       const CallInfo& cinfo = *CI;
@@ -251,7 +346,7 @@ int main(int argc, char* argv[])
           for(unsigned i = 0; i < nvals; i++) {
             Value* incoming = phi->getIncomingValue(i);
             ArgExpKind cur = classifyArgumentExpression(incoming, functionsMap, gcFunctionIndex, possibleAllocators);
-            if (isLoadOfUnprotectedObject(incoming, const_cast<Instruction*>(inst), possibleAllocators, dominatorTree)) {
+            if (checker.isLoadOfUnprotectedObject(incoming, const_cast<Instruction*>(inst))) {
               cur = AK_FRESH;
             }
             if (cur > k) {
@@ -261,7 +356,7 @@ int main(int argc, char* argv[])
           }
         } else {
           k = classifyArgumentExpression(o, functionsMap, gcFunctionIndex, possibleAllocators);
-          if (isLoadOfUnprotectedObject(o, const_cast<Instruction*>(inst), possibleAllocators, dominatorTree)) {
+          if (checker.isLoadOfUnprotectedObject(o, const_cast<Instruction*>(inst))) {
             k = AK_FRESH;
           }
         }
@@ -271,7 +366,7 @@ int main(int argc, char* argv[])
 
         if (VERBOSE) {
           if (k != AK_NOALLOC) {
-            outs() << " Argument " << *o << " in call to " << funName(middleFinfo->function) << " is of kind " << k << 
+            out << " Argument " << *o << " in call to " << funName(middleFinfo->function) << " is of kind " << k << 
             " at " << sourceLocation(inst)  << "\n";
           }
         }
@@ -279,10 +374,18 @@ int main(int argc, char* argv[])
       }
         
       if (nAllocatingArgs >= 2 && nFreshObjects >= 1) {
-        outs() << "WARNING Suspicious call (two or more unprotected arguments) to " << funName(middleFinfo->function) <<
+        out << "WARNING Suspicious call (two or more unprotected arguments) to " << funName(middleFinfo->function) <<
           " at " << funName(finfo.function) << " " << sourceLocation(inst) << "\n";
       }
     }
+    out.flush();
+  });
+
+  for(unsigned fi = 0; fi < nfuns; fi++) {
+    if (!outputs[fi].empty()) {
+      printShardMarker(outs(), functionsOfInterestVector[fi]);
+      outs() << outputs[fi];
+    }
   }
   
   delete m;
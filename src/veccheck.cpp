@@ -13,6 +13,7 @@
 #include <llvm/Support/raw_ostream.h>
 
 #include "vectors.h"
+#include "dataflow.h"
 
 using namespace llvm;
 
@@ -26,8 +27,10 @@ int main(int argc, char* argv[])
   CalledModuleTy *cm = CalledModuleTy::create(m);
   
     // FIXME: this will not discover many call-sites (will not include many interesting contexts)
+  findVectorReturningFunctions(cm);
   printVectorReturningFunctions(cm);
 
   CalledModuleTy::release(cm);
   delete m;
+  printDataflowStats();
 }
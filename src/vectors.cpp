@@ -4,7 +4,10 @@
 #include "table.h"
 #include "callocators.h"
 #include "exceptions.h"
+#include "dataflow.h"
+#include "moduleindex.h"
 
+#include <set>
 #include <unordered_map>
 #include <vector>
 
@@ -12,7 +15,6 @@
 #include <llvm/IR/CallSite.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Instructions.h>
-#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Module.h>
 
 #include <llvm/Support/raw_ostream.h>
@@ -125,18 +127,23 @@ bool isVectorOnlyVarOperation(Value *inst, AllocaInst*& var) {
 
 
 typedef std::vector<bool> ArgsTy; // which argument is a vector (SEXP) or representing a vector type (integer)
-typedef std::vector<bool> VarsTy;
 
 typedef IndexedTable<Argument> ArgIndexTy;
 typedef IndexedTable<AllocaInst> VarIndexTy;
 
 struct VectorsFunctionState;
 typedef std::unordered_map<Function*, VectorsFunctionState> FunctionTableTy;
-typedef std::vector<Function*> FunctionListTy;
 
 typedef IndexedCopyingTable<ArgsTy> ContextIndexTy;
-typedef std::vector<bool> ReturnsOnlyVectorTy;
 
+// the analysis is demand-driven: a function is only analyzed in contexts
+// (vector-ness of arguments) it is queried for, and a function in a context
+// is only re-analyzed when the result of a (function, context) it depends on
+// has changed
+
+typedef std::pair<Function*, unsigned> FunctionContextTy; // function, context index
+typedef std::set<FunctionContextTy> FunctionContextsSetTy;
+typedef std::vector<FunctionContextTy> FunctionContextListTy;
 
 bool isNonDefaultContext(ArgsTy& context) {
   unsigned nargs = context.size();
@@ -172,23 +179,31 @@ std::string funNameWithContext(Function *fun, ArgsTy context) {
   return res;
 }
 
+struct ContextStateTy {
+  bool returnsOnlyVector;
+  bool analyzed; // has been analyzed at least once (before, returnsOnlyVector is false)
+  bool dirty; // dirty iff in the work list
+  FunctionContextsSetTy dependents; // functions in contexts that used the result, to be re-analyzed when it changes
+  
+  ContextStateTy(): returnsOnlyVector(false), analyzed(false), dirty(false), dependents() {};
+};
+
+typedef std::vector<ContextStateTy> ContextStatesTy;
+
 struct VectorsFunctionState {
   Function *fun;
-  bool dirty; // dirty iff in functions work list
 
   VarIndexTy varIndex;
   ArgIndexTy argIndex;
   ContextIndexTy contextIndex;
-  ReturnsOnlyVectorTy returnsOnlyVector;
+  ContextStatesTy contexts; // indexed by context index
   
-  VectorsFunctionState(Function *fun): fun(fun), dirty(false), varIndex(), argIndex(), contextIndex(), returnsOnlyVector() {
+  VectorsFunctionState(Function *fun): fun(fun), varIndex(), argIndex(), contextIndex(), contexts() {
   
     // index variables
-    for(inst_iterator ii = inst_begin(*fun), ie = inst_end(*fun); ii != ie; ++ii) {
-      Instruction *in = &*ii;
-      if (AllocaInst* var = dyn_cast<AllocaInst>(in)) {
-        varIndex.indexOf(var);
-      }
+    const FunctionIndexTy& findex = ModuleIndexTy::get(fun->getParent()).getFunction(fun);
+    for(std::vector<AllocaInst*>::const_iterator vi = findex.vars.begin(), ve = findex.vars.end(); vi != ve; ++vi) {
+      varIndex.indexOf(*vi);
     }
     
     // index arguments
@@ -200,59 +215,73 @@ struct VectorsFunctionState {
     // add default context, it will have index 0
     ArgsTy args(argIndex.size(), false);
     contextIndex.indexOf(args);
-    returnsOnlyVector.resize(1);
-    returnsOnlyVector.at(0) = false;
+    contexts.resize(1);
   }
   
-  void addToWorkList(FunctionListTy& workList) {
-    if (!dirty) {
-      dirty = true;
-      workList.push_back(fun);
-    }    
+  unsigned getContext(ArgsTy& context) {
+    unsigned contextIdx = contextIndex.indexOf(context);
+    if (contextIdx >= contexts.size()) {
+      contexts.resize(contextIdx + 1);
+    }
+    return contextIdx;
   }
-  
-  static VectorsFunctionState& get(FunctionTableTy& functions, Function *f) {
-    auto fsearch = functions.find(f);
-    myassert(fsearch != functions.end());
-    return fsearch->second;
-  }  
 };
 
 struct VrfStateTy {
   FunctionTableTy functions;
+  FunctionContextListTy workList; // functions in contexts to be (re-)analyzed
   
-  VrfStateTy() : functions() {};
-};
-
-struct VectorsBlockState {
-  VarsTy vars; // which vars are "vector" after the basic block executes
-  bool dirty;
+  VrfStateTy() : functions(), workList() {};
   
-  VectorsBlockState(unsigned nvars): vars(nvars, false), dirty(false) {};
-  
-  VectorsBlockState(VarsTy vars, bool dirty): vars(vars), dirty(dirty) {};
+  VectorsFunctionState& get(Function *f) {
+    auto fsearch = functions.find(f);
+    if (fsearch != functions.end()) {
+      return fsearch->second;
+    }
+    auto finsert = functions.insert({f, VectorsFunctionState(f)});
+    return finsert.first->second;
+  }
   
-  bool merge(VectorsBlockState& s) {
-
-    bool updated = false;
-    for(unsigned i = 0; i < vars.size(); i++) {
-      if (vars.at(i)) {
-        if (!s.vars.at(i)) {
-          vars.at(i) = false;
-          updated = true;          
-        }
-      }
-      
+  void addToWorkList(Function *f, unsigned contextIdx) {
+    ContextStateTy& cstate = get(f).contexts.at(contextIdx);
+    if (!cstate.dirty) {
+      cstate.dirty = true;
+      workList.push_back({f, contextIdx});
     }
-    return updated;
   }
+};
+
+VrfStateTy* createVrfState() {
+  return new VrfStateTy();
+}
 
+struct VectorsBlockState {
+  BitSet vars; // which vars are "vector" after the basic block executes
+  
+  VectorsBlockState(): vars() {};
+  VectorsBlockState(unsigned nvars): vars(nvars, false) {};
 };
 
-typedef std::unordered_map<BasicBlock*, VectorsBlockState> BlocksTy;
-typedef std::vector<BasicBlock*> BlockWorkListTy;
+// result of a function in a context, as currently known, registering the caller as dependent on it
+static bool queryReturnsOnlyVector(Function *tgt, ArgsTy& targs, FunctionContextTy caller, VrfStateTy& vrf) {
 
-static bool callReturnsOnlyVector(CallSite& cs, VectorsFunctionState& fstate, VectorsBlockState& s, ArgsTy& context, FunctionTableTy& functions, FunctionListTy& functionsWorkList, CalledModuleTy *cm) {
+  VectorsFunctionState& tstate = vrf.get(tgt);
+  unsigned tcontextIdx = tstate.getContext(targs);
+  ContextStateTy& tcstate = tstate.contexts.at(tcontextIdx);
+  
+  tcstate.dependents.insert(caller);
+  if (!tcstate.analyzed) {
+    // the target function has not yet been explored in this context
+    // it will be, and the caller will be re-analyzed if the result changes
+    vrf.addToWorkList(tgt, tcontextIdx);
+    if (DEBUG) errs() << " = foo() in yet unknown context [ = unknown ] ";
+    return false;
+  }
+  if (DEBUG) errs() << " = foo() in context [ = " << (tcstate.returnsOnlyVector ? "vector" : "unknown") << " ] ";
+  return tcstate.returnsOnlyVector;
+}
+
+static bool callReturnsOnlyVector(CallSite& cs, VectorsFunctionState& fstate, VectorsBlockState& s, ArgsTy& context, FunctionContextTy self, VrfStateTy& vrf, CalledModuleTy *cm) {
 
   if (!cs) {
     return false;
@@ -277,7 +306,7 @@ static bool callReturnsOnlyVector(CallSite& cs, VectorsFunctionState& fstate, Ve
     if (LoadInst *li = dyn_cast<LoadInst>(targ)) {
       if (AllocaInst *avar = dyn_cast<AllocaInst>(li->getPointerOperand())) { // passing a variable
         unsigned avidx = fstate.varIndex.indexOf(avar);
-        targs.at(i) = s.vars.at(avidx);
+        targs.at(i) = s.vars.get(avidx);
         continue;
       }
     }
@@ -301,44 +330,12 @@ static bool callReturnsOnlyVector(CallSite& cs, VectorsFunctionState& fstate, Ve
   
   if (DEBUG) errs() << " [target " << funNameWithContext(tgt, targs) << "]";
 
-  VectorsFunctionState& tstate = VectorsFunctionState::get(functions, tgt);
-  unsigned tcontextIdx = tstate.contextIndex.indexOf(targs);
-
-  if (tcontextIdx < tstate.returnsOnlyVector.size()) {
-    if (DEBUG) errs() << " = foo() in context [ = " << (tstate.returnsOnlyVector.at(tcontextIdx) ? "vector" : "unknown") << " ] " << sourceLocation(cs.getInstruction()) << "\n";
-    return tstate.returnsOnlyVector.at(tcontextIdx);
-
-  } else {
-    // the target function has not yet been explored in this context
-    // we have just added that context to that function, so lets mark it dirty
-    // we have not expanded tstate.retursOnlyVector, it will be done when tstate is re-visited
-    
-    tstate.addToWorkList(functionsWorkList);
-                
-    // and lets use the default context for the function
-    if (DEBUG) errs() << " = foo() in DEFAULT context [ = " << (tstate.returnsOnlyVector.at(0) ? "vector" : "unknown") << " ] " << sourceLocation(cs.getInstruction()) << "\n";
-    if (DEBUG) {
-      errs() << "Function " << funName(tgt) << " now has these contexts: (fstate=" << &tstate << ")\n";
-      unsigned ntcontexts = tstate.contextIndex.size();
-      for(unsigned i = 0; i < ntcontexts; i++) {
-        errs() << "  " << funNameWithContext(tgt, tstate.contextIndex.at(i)) << " ";
-        if (i < tstate.returnsOnlyVector.size()) {
-          if (tstate.returnsOnlyVector.at(i)) {
-            errs() << "returns vector";
-          } else {
-            errs() << "may return non-vector";
-          }
-        } else {
-          errs() << "yet unknown";
-        }
-        errs() << "\n";
-      }
-    }
-    return tstate.returnsOnlyVector.at(0);
-  }
+  bool res = queryReturnsOnlyVector(tgt, targs, self, vrf);
+  if (DEBUG) errs() << sourceLocation(cs.getInstruction()) << "\n";
+  return res;
 }
 
-static bool valueIsVector(Value *val, VectorsFunctionState& fstate, VectorsBlockState& s, ArgsTy& context, FunctionTableTy& functions, FunctionListTy& functionsWorkList, CalledModuleTy *cm) {
+static bool valueIsVector(Value *val, VectorsFunctionState& fstate, VectorsBlockState& s, ArgsTy& context, FunctionContextTy self, VrfStateTy& vrf, CalledModuleTy *cm) {
           
   if (Argument *arg = dyn_cast<Argument>(val)) {  // = arg
     unsigned aidx = fstate.argIndex.indexOf(arg);
@@ -348,7 +345,7 @@ static bool valueIsVector(Value *val, VectorsFunctionState& fstate, VectorsBlock
   if (LoadInst *li = dyn_cast<LoadInst>(val)) { // = srcVar
     if (AllocaInst *srcVar = dyn_cast<AllocaInst>(li->getPointerOperand())) { // var = srcVar
       unsigned svidx = fstate.varIndex.indexOf(srcVar);
-      return s.vars.at(svidx);
+      return s.vars.get(svidx);
     }
   }
           
@@ -361,37 +358,28 @@ static bool valueIsVector(Value *val, VectorsFunctionState& fstate, VectorsBlock
   if (cs && cs.getCalledFunction()) {
     Function *tgt = cs.getCalledFunction();
     if (isSEXP(tgt->getReturnType())) {
-      return callReturnsOnlyVector(cs, fstate, s, context, functions, functionsWorkList, cm);
+      return callReturnsOnlyVector(cs, fstate, s, context, self, vrf, cm);
     }
   }
 
   return false;
 }
 
-static void analyzeFunctionInContext(VectorsFunctionState& fstate, unsigned contextIdx, FunctionTableTy& functions, FunctionListTy& functionsWorkList, CalledModuleTy *cm) {
-
-  Function *fun = fstate.fun;
-  ArgsTy context = fstate.contextIndex.at(contextIdx);
-
-  unsigned nvars = fstate.varIndex.size();
-  
-  BlocksTy blocks;
-  BlockWorkListTy workList;
+struct VectorsAnalysis {
+  typedef VectorsBlockState StateTy;
+  static const DataflowDirection direction = DF_FORWARD;
   
-  BasicBlock *entryb = &fun->getEntryBlock();
-  blocks.insert({entryb, VectorsBlockState(nvars)});
-  workList.push_back(entryb);
+  VectorsFunctionState& fstate;
+  ArgsTy& context;
+  FunctionContextTy self;
+  VrfStateTy& vrf;
+  CalledModuleTy *cm;
   
-  if (DEBUG) errs() << "Analyzing function " << funNameWithContext(fun, context) << "\n";
+  VectorsAnalysis(VectorsFunctionState& fstate, ArgsTy& context, FunctionContextTy self, VrfStateTy& vrf, CalledModuleTy *cm):
+    fstate(fstate), context(context), self(self), vrf(vrf), cm(cm) {};
   
-  while(!workList.empty()) {
-    BasicBlock *bb = workList.back();
-    workList.pop_back();
-    
-    auto bsearch = blocks.find(bb);
-    myassert(bsearch != blocks.end());
-    bsearch->second.dirty = false;
-    VectorsBlockState s = bsearch->second; // copy
+  // returns false when the function may return a non-vector
+  bool transfer(BasicBlock *bb, StateTy& s) {
     
     for(BasicBlock::iterator ii = bb->begin(), ie = bb->end(); ii != ie; ++ii) {
       Instruction *in = &*ii;
@@ -401,7 +389,7 @@ static void analyzeFunctionInContext(VectorsFunctionState& fstate, unsigned cont
 
           unsigned vidx = fstate.varIndex.indexOf(var);
           if (DEBUG) errs() << "var " << varName(var) << " ";
-          s.vars.at(vidx) = valueIsVector(si->getValueOperand(), fstate, s, context, functions, functionsWorkList, cm);
+          s.vars.set(vidx, valueIsVector(si->getValueOperand(), fstate, s, context, self, vrf, cm));
         }
         continue;
       }
@@ -409,7 +397,7 @@ static void analyzeFunctionInContext(VectorsFunctionState& fstate, unsigned cont
       AllocaInst *var;
       if (isVectorOnlyVarOperation(in, var)) { // LENGTH(var) and friends
          unsigned vidx = fstate.varIndex.indexOf(var);
-         s.vars.at(vidx) = true;
+         s.vars.set(vidx);
          if (DEBUG) errs() << "var is vector (vector-only-operation) [" << varName(var) << "] " << sourceLocation(in) << "\n";
          continue;
       }
@@ -420,91 +408,86 @@ static void analyzeFunctionInContext(VectorsFunctionState& fstate, unsigned cont
 
     if (ReturnInst *r = dyn_cast<ReturnInst>(t)) {
     
-      if (valueIsVector(r->getReturnValue(), fstate, s, context, functions, functionsWorkList, cm)) {
-        continue;
+      if (valueIsVector(r->getReturnValue(), fstate, s, context, self, vrf, cm)) {
+        return true;
       }
 
       // either unsupported return, or supported (above) but one that discovered non-vector
-      fstate.returnsOnlyVector.at(contextIdx) = false;
-      if (DEBUG) errs() << "Function " << funNameWithContext(fun, context) << " may return non-vector " << sourceLocation(t) << "\n";
-      return;
-      
-    }    
-
-    // TODO: handle guards on types
-    
-    // conservatively add all successors    
-    for(int i = 0, nsucc = t->getNumSuccessors(); i < nsucc; i++) {
-      BasicBlock *succ = t->getSuccessor(i);
-      auto ssearch = blocks.find(succ);
-      if (ssearch == blocks.end()) {
-      
-        // not yet explored block
-        VectorsBlockState sstate(s.vars, true /* dirty */);
-        blocks.insert({succ, sstate});
-        workList.push_back(succ);
-
-      } else {
-        VectorsBlockState& pstate = ssearch->second;
-        
-        // merge
-        if (pstate.merge(s) && !pstate.dirty) {
-          pstate.dirty = true;
-          workList.push_back(succ);
-        }
-      }
+      if (DEBUG) errs() << "Function " << funNameWithContext(fstate.fun, context) << " may return non-vector " << sourceLocation(t) << "\n";
+      return false;
     }
+    
+    // TODO: handle guards on types
+    //   (conservatively, all successors are added)
+    return true;
   }
-  fstate.returnsOnlyVector.at(contextIdx) = true;
-  if (DEBUG) errs() << "Function " << funNameWithContext(fun, context) << " returns only vectors\n";
-}
+  
+  // a variable is a vector only if it is on all paths
+  bool join(StateTy& dst, StateTy& src) {
+    return dst.vars.intersectWith(src.vars);
+  }
+};
+
+static DataflowStatsTy vectorsStats("vectors");
 
-static void analyzeFunction(VectorsFunctionState& fstate, FunctionTableTy& functions, FunctionListTy& functionsWorkList, CalledModuleTy *cm) {
+static bool analyzeFunctionInContext(VectorsFunctionState& fstate, unsigned contextIdx, VrfStateTy& vrf, CalledModuleTy *cm) {
 
   Function *fun = fstate.fun;
+  ArgsTy context = fstate.contextIndex.at(contextIdx);
+  FunctionContextTy self(fun, contextIdx);
   
-  unsigned ncontexts = fstate.contextIndex.size();
-  myassert(fstate.returnsOnlyVector.size() <= ncontexts);
-  fstate.returnsOnlyVector.resize(ncontexts); // add new elements, contexts may have been added in the meantime
+  if (fun->isDeclaration()) {
+    return false;
+  }
+
+  unsigned nvars = fstate.varIndex.size();
   
-  ReturnsOnlyVectorTy before = fstate.returnsOnlyVector;
+  if (DEBUG) errs() << "Analyzing function " << funNameWithContext(fun, context) << "\n";
   
-  if (DEBUG) errs() << "Analyzing (all " << ncontexts << " contexts of) function " << funName(fun) << " fstate " << &fstate << "\n";
+  VectorsAnalysis analysis(fstate, context, self, vrf, cm);
+  DataflowSolver<VectorsAnalysis> solver(fun, analysis, &vectorsStats);
+  solver.seed(&fun->getEntryBlock(), VectorsBlockState(nvars));
   
-  for(unsigned i = 0; i < ncontexts; i++) {
-    analyzeFunctionInContext(fstate, i, functions, functionsWorkList, cm);  
+  if (!solver.solve()) {
+    return false;
   }
-  
-  if (before != fstate.returnsOnlyVector) {
-    // mark dirty all functions calling this function
+  if (DEBUG) errs() << "Function " << funNameWithContext(fun, context) << " returns only vectors\n";
+  return true;
+}
+
+// analyze functions in contexts from the work list, until there is no change
+static void solve(VrfStateTy& vrf, CalledModuleTy *cm) {
+
+  while(!vrf.workList.empty()) {
+    FunctionContextTy fc = vrf.workList.back();
+    vrf.workList.pop_back();
     
-    for(Value::user_iterator ui = fun->user_begin(), ue = fun->user_end(); ui != ue; ++ui) {
-      User *u = *ui;
-
-      if (Instruction *in = dyn_cast<Instruction>(u)) {
-        if (BasicBlock *bb = dyn_cast<BasicBlock>(in->getParent())) {
-          Function *pf = bb->getParent();
-          if (isSEXP(pf->getReturnType())) {
-            VectorsFunctionState& pstate = VectorsFunctionState::get(functions, pf);
-            pstate.addToWorkList(functionsWorkList);
-            if (DEBUG) errs() << "Marking dirty affected caller function " << funName(pf) << "\n";
-            // NOTE: in case of recursive functions, we may be re-adding fun
-          }
-        }
-      }
-    }    
+    VectorsFunctionState& fstate = vrf.get(fc.first);
+    fstate.contexts.at(fc.second).dirty = false;
+    
+    bool res = analyzeFunctionInContext(fstate, fc.second, vrf, cm);
+    
+    ContextStateTy& cstate = fstate.contexts.at(fc.second); // contexts may have been added in the meantime
+    cstate.analyzed = true;
+    if (cstate.returnsOnlyVector == res) {
+      continue;
+    }
+    cstate.returnsOnlyVector = res;
+    
+    // re-analyze the users of the result
+    //   NOTE: in case of recursive functions, we may be re-adding this function in this context
+    for(FunctionContextsSetTy::iterator di = cstate.dependents.begin(), de = cstate.dependents.end(); di != de; ++di) {
+      if (DEBUG) errs() << "Marking dirty affected caller function " << funName(di->first) << "\n";
+      vrf.addToWorkList(di->first, di->second);
+    }
   }
 }
 
+// full-module mode: analyze all functions returning SEXP, in their default contexts
 void findVectorReturningFunctions(CalledModuleTy *cm) {
 
-  VrfStateTy* res = new VrfStateTy();
-  cm->setVrfState(res);
-  
-  FunctionTableTy &functions = res->functions;
-  FunctionListTy workList;   // functions to be re-analyzed
+  VrfStateTy& vrf = *cm->getVrfState();
  
-  // add some functions to the worklist, with default contexts  
   Module *m = cm->getModule();
   for(Module::iterator fi = m->begin(), fe = m->end(); fi != fe; ++fi) {
     Function *f = &*fi;
@@ -512,20 +495,9 @@ void findVectorReturningFunctions(CalledModuleTy *cm) {
       continue;
       // if a function does not return an SEXP, it definitely does not return a vector
     }
-    VectorsFunctionState fstate(f);
-    auto finsert = functions.insert({f, fstate});
-    myassert(finsert.second);
-
-    fstate.addToWorkList(workList);
-  }
-
-  while(!workList.empty()) {
-    VectorsFunctionState& fstate = VectorsFunctionState::get(functions, workList.back());
-    workList.pop_back();
-    fstate.dirty = false;
-
-    analyzeFunction(fstate, functions, workList, cm);
+    vrf.addToWorkList(f, 0 /* default context */);
   }
+  solve(vrf, cm);
 }
 
 void printVectorReturningFunctions(FunctionTableTy *functionsPtr) {
@@ -538,13 +510,13 @@ void printVectorReturningFunctions(FunctionTableTy *functionsPtr) {
     VectorsFunctionState& fstate = fi->second;
     
     unsigned ncontexts = fstate.contextIndex.size();
-    myassert(ncontexts == fstate.returnsOnlyVector.size());
+    myassert(ncontexts == fstate.contexts.size());
     
     bool seenTrue = false;
     bool seenFalse = false;
     
     for(unsigned i = 0; i < ncontexts; i++) {
-      if (fstate.returnsOnlyVector.at(i)) {
+      if (fstate.contexts.at(i).returnsOnlyVector) {
         seenTrue = true;
       } else {
         seenFalse = true;
@@ -556,7 +528,7 @@ void printVectorReturningFunctions(FunctionTableTy *functionsPtr) {
         errs() << "  " << funName(fun) << "\n";
       } else {
         for(unsigned i = 0; i < ncontexts; i++) {
-          if (fstate.returnsOnlyVector.at(i)) {
+          if (fstate.contexts.at(i).returnsOnlyVector) {
             errs() << "  " << funNameWithContext(fun, fstate.contextIndex.at(i)) << "\n";
           }
         }
@@ -575,41 +547,20 @@ void freeVrfState(VrfStateTy *vrfState) {
 
 bool isVectorReturningFunction(Function *fun, ArgsTy context, CalledModuleTy* cm) {
 
-  FunctionTableTy* functionsPtr = &(cm->getVrfState()->functions);
-  FunctionListTy workList;
-  FunctionTableTy& functions = *functionsPtr;
-
   if (!isSEXP(fun->getReturnType())) {
     return false;
   }
 
-  unsigned contextIdx = 0;
-  
-  auto fsearch = functions.find(fun);
-  if (fsearch == functions.end()) {
-    VectorsFunctionState fstate(fun);
-    contextIdx = fstate.contextIndex.indexOf(context); // add context
-    auto finsert = functions.insert({fun, fstate});
-    myassert(finsert.second);
-
-    fstate.addToWorkList(workList);    
-  } else {
-    VectorsFunctionState& fstate = fsearch->second;
-    contextIdx = fstate.contextIndex.indexOf(context); // add context
-    
-    fstate.addToWorkList(workList);    
-  }
+  VrfStateTy& vrf = *cm->getVrfState();
+  VectorsFunctionState& fstate = vrf.get(fun);
+  unsigned contextIdx = fstate.getContext(context);
   
-  while(!workList.empty()) {
-    VectorsFunctionState& fstate = VectorsFunctionState::get(functions, workList.back());
-    workList.pop_back();
-    fstate.dirty = false;
-
-    analyzeFunction(fstate, functions, workList, cm);
+  if (!fstate.contexts.at(contextIdx).analyzed) {
+    vrf.addToWorkList(fun, contextIdx);
+    solve(vrf, cm);
   }
   
-  VectorsFunctionState& fstate = VectorsFunctionState::get(functions, fun);
-  bool res = fstate.returnsOnlyVector.at(contextIdx);
+  bool res = fstate.contexts.at(contextIdx).returnsOnlyVector;
 
   if (DEBUG) errs() << "isVectorReturningFunction: function " << funNameWithContext(fun, context) << (res ? "returns only vector" : "may return non-vector") << "\n";
   
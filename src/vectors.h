@@ -1,6 +1,7 @@
 
 struct VrfStateTy;
 class CalledModuleTy;
+VrfStateTy* createVrfState();
 void findVectorReturningFunctions(CalledModuleTy *cm);
 
 #ifndef RCHK_VECTORS_H
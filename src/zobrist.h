@@ -0,0 +1,160 @@
+#ifndef RCHK_ZOBRIST_H
+#define RCHK_ZOBRIST_H
+
+#include <map>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// containers that keep a hash of their contents up to date incrementally
+// (Zobrist hashing)
+//
+// the hash is the XOR of keys of all entries, so adding or removing an entry
+// only costs computing its key; the keys are pseudo-random, obtained by
+// mixing the hash of the entry (a table of random numbers would need the
+// variables upfront)
+
+inline size_t zobristKey(size_t h) {
+  // splitmix64 finalizer
+  uint64_t z = (uint64_t) h + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return (size_t) (z ^ (z >> 31));
+}
+
+// an ordered map with a hash
+//   EntryHash hashes (key, value) pairs, equal entries have to have equal hashes
+//
+//   the entries can only be modified via set/insert/erase (iterators are constant),
+//   operator[] is provided for assignment only
+
+template <class Key, class Value, class EntryHash> class ZobristMapTy {
+
+  typedef std::map<Key, Value> MapTy;
+  MapTy map;
+  size_t hashcode;
+
+  size_t key(const Key& k, const Value& v) const {
+    EntryHash hasher;
+    return zobristKey(hasher(k, v));
+  }
+
+  public:
+    typedef typename MapTy::const_iterator const_iterator;
+    typedef const_iterator iterator;
+    typedef typename MapTy::value_type value_type;
+
+    class EntryRefTy {
+      ZobristMapTy& m;
+      const Key k;
+
+      public:
+        EntryRefTy(ZobristMapTy& m, const Key& k): m(m), k(k) {}
+        EntryRefTy& operator=(const Value& v) {
+          m.set(k, v);
+          return *this;
+        }
+    };
+
+    ZobristMapTy(): map(), hashcode(0) {}
+
+    size_t hash() const { return hashcode; }
+
+    const_iterator begin() const { return map.begin(); }
+    const_iterator end() const { return map.end(); }
+    const_iterator find(const Key& k) const { return map.find(k); }
+    size_t count(const Key& k) const { return map.count(k); }
+    size_t size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+
+    void set(const Key& k, const Value& v) {
+      auto minsert = map.insert({k, v});
+      if (!minsert.second) {
+        hashcode ^= key(k, minsert.first->second);
+        minsert.first->second = v;
+      }
+      hashcode ^= key(k, v);
+    }
+
+    EntryRefTy operator[](const Key& k) { return EntryRefTy(*this, k); }
+
+    std::pair<const_iterator, bool> insert(const value_type& e) {
+      auto minsert = map.insert(e);
+      if (minsert.second) {
+        hashcode ^= key(e.first, e.second);
+      }
+      return minsert;
+    }
+
+    size_t erase(const Key& k) {
+      auto msearch = map.find(k);
+      if (msearch == map.end()) {
+        return 0;
+      }
+      erase(msearch);
+      return 1;
+    }
+
+    const_iterator erase(const_iterator it) {
+      hashcode ^= key(it->first, it->second);
+      return map.erase(it);
+    }
+
+    void clear() {
+      map.clear();
+      hashcode = 0;
+    }
+
+    bool operator==(const ZobristMapTy& other) const { return hashcode == other.hashcode && map == other.map; }
+    bool operator!=(const ZobristMapTy& other) const { return !(*this == other); }
+};
+
+// a vector used as a stack, with a hash
+//   ElemHash hashes elements, the position of the element is included in the key
+
+template <class Elem, class ElemHash> class ZobristStackTy {
+
+  typedef std::vector<Elem> VectorTy;
+  VectorTy elems;
+  size_t hashcode;
+
+  size_t key(size_t pos, const Elem& e) const {
+    ElemHash hasher;
+    return zobristKey(hasher(e) ^ zobristKey(pos));
+  }
+
+  public:
+    typedef typename VectorTy::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    ZobristStackTy(): elems(), hashcode(0) {}
+
+    size_t hash() const { return hashcode; }
+
+    const_iterator begin() const { return elems.begin(); }
+    const_iterator end() const { return elems.end(); }
+    size_t size() const { return elems.size(); }
+    bool empty() const { return elems.empty(); }
+    const Elem& back() const { return elems.back(); }
+    const Elem& operator[](size_t i) const { return elems[i]; }
+
+    void push_back(const Elem& e) {
+      hashcode ^= key(elems.size(), e);
+      elems.push_back(e);
+    }
+
+    void pop_back() {
+      hashcode ^= key(elems.size() - 1, elems.back());
+      elems.pop_back();
+    }
+
+    void clear() {
+      elems.clear();
+      hashcode = 0;
+    }
+
+    bool operator==(const ZobristStackTy& other) const { return hashcode == other.hashcode && elems == other.elems; }
+    bool operator!=(const ZobristStackTy& other) const { return !(*this == other); }
+};
+
+#endif